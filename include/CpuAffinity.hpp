@@ -0,0 +1,91 @@
+///
+/// @file  CpuAffinity.hpp
+/// @brief The CpuAffinity class pins the threads of primecount's
+///        parallel algorithms to specific CPU cores so that the
+///        threads do not migrate between CPU cores and lose the
+///        sieve array that resides in the CPU core's caches.
+///
+///        Supported affinity modes:
+///
+///        * compact: Threads are placed as close to each other
+///                   as possible, first onto the hyper-threads of
+///                   the same CPU core, then onto the CPU cores
+///                   sharing the same L2 cache.
+///        * scatter: Threads are distributed as evenly as possible
+///                   across the L2 cache domains and CPU sockets.
+///        * 0,2,4-7: Explicit list of CPU core IDs (as reported by
+///                   the operating system).
+///
+///        The CPU topology is read from /sys/devices/system/cpu,
+///        hence thread pinning is only supported on Linux.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef CPUAFFINITY_HPP
+#define CPUAFFINITY_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace primecount {
+
+class CpuAffinity
+{
+public:
+  CpuAffinity(const std::string& affinity);
+  void bind_thread(int thread_num) const;
+  int64_t l1_cache_size(int thread_num) const;
+  int64_t l2_cache_size(int thread_num) const;
+  int64_t max_l1_cache_size() const;
+  int64_t max_l2_cache_size() const;
+
+  struct Cpu
+  {
+    int id = 0;
+    int package = 0;
+    int core = 0;
+    int l2_domain = 0;
+    int64_t l1_cache_size = 0;
+    int64_t l2_cache_size = 0;
+  };
+
+private:
+  const Cpu& get_cpu(int thread_num) const;
+  std::vector<Cpu> cpus_;
+};
+
+/// Pin the threads of all parallel algorithms
+/// e.g. affinity = "compact", "scatter", "0-3,8".
+/// affinity = "none" disables thread pinning.
+///
+void set_affinity(const std::string& affinity);
+
+/// Returns the affinity set using set_affinity()
+std::string get_affinity();
+
+/// Returns true if thread pinning is enabled
+bool is_affinity();
+
+/// Pin the calling OpenMP thread to its CPU core.
+/// Does nothing if thread pinning is disabled.
+///
+void bind_thread();
+
+/// L1 data cache size of the CPU core the calling
+/// thread is pinned to, or 0 if thread pinning is disabled.
+///
+int64_t thread_l1_cache_size();
+
+/// L2 cache size of the CPU core the calling thread
+/// is pinned to, or 0 if thread pinning is disabled.
+///
+int64_t thread_l2_cache_size();
+
+} // namespace
+
+#endif
@@ -0,0 +1,177 @@
+///
+/// @file  Divider128.hpp
+/// @brief Fast division of 128-bit dividends by a 64-bit divisor
+///        using a precomputed reciprocal. Dividing a 128-bit
+///        integer by a 64-bit integer is slow on most CPUs
+///        because the compiler calls a runtime library function
+///        (__udivti3) instead of using a CPU instruction. If the
+///        same divisor is used many times it pays off to
+///        precompute the divisor's reciprocal, then each division
+///        only requires 2 multiplications and a few additions.
+///
+///        The quotient must fit into 64 bits i.e. dividend / divisor
+///        < 2^64 which is always the case for the divisions
+///        x / (prime * primes[l]) of the special leaves.
+///
+///        Divider128 is only used if primecount is built with
+///        cmake -DWITH_DIVIDER128=ON, it is faster on CPUs with
+///        a slow hardware 128 / 64 bit division (e.g. Intel CPUs
+///        before Ice Lake). On newer CPUs the hardware division
+///        is usually faster. The dividers use 16 bytes of memory
+///        per prime <= y.
+///
+///        Algorithm: Niels Möller and Torbjörn Granlund,
+///        "Improved division by invariant integers",
+///        IEEE Transactions on Computers, 2011 (Algorithm 4).
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef DIVIDER128_HPP
+#define DIVIDER128_HPP
+
+#include <fast_div.hpp>
+#include <int128_t.hpp>
+
+#include <stdint.h>
+#include <cassert>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace primecount {
+
+class Divider128
+{
+public:
+  Divider128() = default;
+
+  Divider128(uint64_t d) :
+    d_(d)
+  {
+    assert(d > 0);
+#if defined(HAVE_INT128_T)
+    // v = floor((2^128 - 1) / dn) - 2^64
+    uint64_t dn = d << clz(d);
+    uint128_t num = ((uint128_t) ~dn << 64) | ~(uint64_t) 0;
+    v_ = (uint64_t) (num / dn);
+#endif
+  }
+
+  uint64_t divisor() const
+  {
+    return d_;
+  }
+
+  /// 64-bit dividend: use the CPU's division instruction
+  template <typename T>
+  typename std::enable_if<(sizeof(T) <= sizeof(uint64_t)), uint64_t>::type
+  divide(T u) const
+  {
+    return (uint64_t) u / d_;
+  }
+
+#if defined(HAVE_INT128_T)
+
+  /// 128-bit dividend: requires u / d < 2^64
+  template <typename T>
+  typename std::enable_if<(sizeof(T) > sizeof(uint64_t)), uint64_t>::type
+  divide(T u) const
+  {
+    uint128_t n = (uint128_t) u;
+
+    if (n <= std::numeric_limits<uint64_t>::max())
+      return (uint64_t) n / d_;
+
+    assert((n >> 64) < d_);
+    int shift = clz(d_);
+    uint64_t d = d_ << shift;
+    n <<= shift;
+
+    uint64_t u1 = (uint64_t) (n >> 64);
+    uint64_t u0 = (uint64_t) n;
+    uint128_t q = (uint128_t) v_ * u1 + n;
+    uint64_t q1 = (uint64_t) (q >> 64) + 1;
+    uint64_t q0 = (uint64_t) q;
+    uint64_t r = u0 - q1 * d;
+
+    // branchfree: r > q0 is unpredictable
+    uint64_t mask = 0 - (uint64_t) (r > q0);
+    q1 += mask;
+    r += mask & d;
+
+    // very unlikely
+    if (r >= d)
+      q1++;
+
+    return q1;
+  }
+
+#endif
+
+private:
+  /// Count leading zero bits, d > 0
+  static int clz(uint64_t d)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(d);
+#else
+    int bits = 0;
+    for (; !(d >> 63); d <<= 1)
+      bits++;
+    return bits;
+#endif
+  }
+
+  uint64_t d_ = 1;
+  uint64_t v_ = 0;
+};
+
+/// Returns the dividers of all primes if x does not
+/// fit into 64 bits and if primecount has been built
+/// with ENABLE_DIVIDER128, else returns an empty vector.
+///
+template <typename T, typename Primes>
+std::vector<Divider128> divider128_vector(T x, const Primes& primes)
+{
+  std::vector<Divider128> dividers;
+
+#if defined(HAVE_INT128_T) && \
+    defined(ENABLE_DIVIDER128)
+  if (x > std::numeric_limits<uint64_t>::max())
+  {
+    dividers.reserve(primes.size());
+    dividers.emplace_back();
+    for (std::size_t i = 1; i < primes.size(); i++)
+      dividers.emplace_back((uint64_t) primes[i]);
+  }
+#else
+  (void) x;
+  (void) primes;
+#endif
+
+  return dividers;
+}
+
+/// Returns x / primes[i], requires x / primes[i] < 2^64.
+/// Uses the precomputed divider of primes[i] if
+/// x does not fit into 64 bits.
+///
+template <typename T, typename Primes>
+int64_t fast_div(T x,
+                 int64_t i,
+                 const Primes& primes,
+                 const std::vector<Divider128>& dividers)
+{
+  if (sizeof(T) > sizeof(uint64_t) && !dividers.empty())
+    return (int64_t) dividers[i].divide(x);
+
+  return (int64_t) fast_div(x, primes[i]);
+}
+
+} // namespace
+
+#endif
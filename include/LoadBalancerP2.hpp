@@ -0,0 +1,37 @@
+///
+/// @file  LoadBalancerP2.hpp
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef LOADBALANCERP2_HPP
+#define LOADBALANCERP2_HPP
+
+#include <int128_t.hpp>
+#include <stdint.h>
+
+namespace primecount {
+
+class LoadBalancerP2
+{
+public:
+  LoadBalancerP2(maxint_t x, int64_t low, int64_t z, int threads);
+  int get_threads() const;
+  bool get_work(int64_t* low, int64_t* high);
+
+private:
+  void print_status() const;
+  int64_t low_;
+  int64_t start_;
+  int64_t z_;
+  int64_t min_dist_;
+  int threads_;
+  int precision_;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,75 @@
+///
+/// @file  PhiTable.hpp
+/// @brief The PhiTable class is a read-only lookup table of
+///        phi(x, a) results for small x (x <= 65535) and
+///        PhiTiny::max_a() < a < 100. phi(x, a) counts the
+///        numbers <= x that are not divisible by any of the
+///        first a primes.
+///
+///        The table is built once and then shared by all
+///        threads, hence the phi(x, a) computations in
+///        generate_phi() do not need their own cache.
+///        As a > 8 we only store phi(x, a) for the numbers
+///        x that are coprime to 2, 3 and 5 (8 numbers per
+///        30 numbers), the table uses about 3 megabytes.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef PHITABLE_HPP
+#define PHITABLE_HPP
+
+#include <PhiTiny.hpp>
+
+#include <stdint.h>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+namespace primecount {
+
+class PhiTable
+{
+public:
+  PhiTable();
+
+  static int64_t max_x()
+  {
+    return std::numeric_limits<uint16_t>::max();
+  }
+
+  static int64_t max_a()
+  {
+    return 99;
+  }
+
+  static bool is_cached(int64_t x, int64_t a)
+  {
+    return x <= max_x() &&
+           a <= max_a() &&
+           a > PhiTiny::max_a();
+  }
+
+  int64_t phi(int64_t x, int64_t a) const
+  {
+    assert(is_cached(x, a));
+    return phi_[a][x / 30 * 8 + index_[x % 30]];
+  }
+
+private:
+  static const std::array<int, 30> index_;
+  std::array<std::vector<uint16_t>, 100> phi_;
+};
+
+/// Returns the PhiTable shared by all threads,
+/// it is initialized at the first call.
+///
+const PhiTable& get_phi_table();
+
+} // namespace
+
+#endif
@@ -3,13 +3,27 @@
 /// @brief phi(x, a) counts the numbers <= x that are not
 ///        divisible by any of the first a primes.
 ///        PhiTiny computes phi(x, a) in constant time
-///        for a <= 6 using lookup tables.
+///        for a <= 8 using lookup tables.
 ///
 ///        phi(x, a) = (x / pp) * φ(a) + phi(x % pp, a)
 ///        pp = 2 * 3 * ... * prime[a]
 ///        φ(a) = \prod_{i=1}^{a} (prime[i] - 1)
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+///        For a <= 6 phi(x % pp, a) is stored in an int16_t
+///        array. For a = 7 and a = 8 (pp = 510510 and
+///        pp = 9699690) this would use too much memory, hence
+///        we use a compressed table similar to PiTable: 1 bit
+///        per odd number (set if the number is not divisible
+///        by any of the first a primes) and a count of the
+///        set bits below each 128 numbers. A lookup
+///        then requires a single popcount instruction.
+///
+///        The batch version phi(xs, n, a, out) computes
+///        phi(x, a) for many x using the same a, it replaces
+///        the division by pp with a multiplication by its
+///        precomputed reciprocal (if libdivide is available).
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -18,9 +32,12 @@
 #ifndef PHITINY_HPP
 #define PHITINY_HPP
 
+#include <popcnt.hpp>
+
 #include <stdint.h>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <limits>
 #include <vector>
 
@@ -37,9 +54,21 @@ public:
     assert(a <= max_a());
 
     T pp = prime_products[a];
-    return (x / pp) * totients[a] + phi_[a][x % pp];
+    T q = x / pp;
+    T r = x - q * pp;
+
+    if (a <= max_a_small)
+      return q * totients[a] + phi_[a][r];
+    else
+      return q * totients[a] + phi_bits((uint64_t) r, a);
   }
 
+  /// Batch version: out[i] = phi(xs[i], a)
+  void phi(const uint64_t* xs,
+           std::size_t n,
+           int64_t a,
+           uint64_t* out) const;
+
   static int64_t get_c(int64_t y)
   {
     assert(y >= 0);
@@ -56,11 +85,34 @@ public:
   }
 
 private:
-  std::array<std::vector<int16_t>, 7> phi_;
-  static const std::array<int, 7> primes;
-  static const std::array<int, 7> prime_products;
-  static const std::array<int, 7> totients;
-  static const std::array<int, 13> pi;
+  /// Largest a using the uncompressed int16_t tables
+  static const int max_a_small = 6;
+
+  struct PhiData
+  {
+    uint64_t bits;
+    uint32_t count;
+  };
+
+  /// phi(x, a) for x < pp and a > max_a_small.
+  /// Bit i of the table corresponds to the odd number 2 * i + 1.
+  int64_t phi_bits(uint64_t x, int64_t a) const
+  {
+    // number of odd numbers <= x
+    uint64_t n = (x + 1) / 2;
+    const PhiData& data = phi_bits_[a - max_a_small - 1][n / 64];
+    uint64_t bitmask = (1ull << (n % 64)) - 1;
+    return data.count + popcnt64(data.bits & bitmask);
+  }
+
+  void init_phi_bits(int64_t a);
+
+  std::array<std::vector<int16_t>, max_a_small + 1> phi_;
+  std::array<std::vector<PhiData>, 2> phi_bits_;
+  static const std::array<int, 9> primes;
+  static const std::array<int, 9> prime_products;
+  static const std::array<int, 9> totients;
+  static const std::array<int, 19> pi;
 };
 
 extern const PhiTiny phiTiny;
@@ -79,6 +131,17 @@ T phi_tiny(T x, int64_t a)
     return phiTiny.phi(x, a);
 }
 
+/// Batch version of phi_tiny(x, a):
+/// out[i] = phi_tiny(xs[i], a) for 0 <= i < n
+///
+inline void phi_tiny(const uint64_t* xs,
+                     std::size_t n,
+                     int64_t a,
+                     uint64_t* out)
+{
+  phiTiny.phi(xs, n, a, out);
+}
+
 } // namespace
 
 #endif
@@ -5,7 +5,7 @@
 ///        and returns the number of primes <= n in O(1)
 ///        operations.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -35,11 +35,51 @@ public:
     return pi_[n / 64].prime_count + popcnt64(pi_[n / 64].bits & bitmask);
   }
 
+  /// Returns the smallest prime >= n or
+  /// 0 if there is no such prime <= max.
+  /// This allows multiple threads to iterate over
+  /// the primes of the same (read-only) PiTable
+  /// without having to sieve them again.
+  ///
+  uint64_t next_prime(uint64_t n) const
+  {
+    if (n > max_)
+      return 0;
+
+    uint64_t i = n / 64;
+    uint64_t bits = pi_[i].bits & (0xffffffffffffffffull << (n % 64));
+
+    while (!bits)
+    {
+      if (++i >= pi_.size())
+        return 0;
+      bits = pi_[i].bits;
+    }
+
+    return i * 64 + ctz64(bits);
+  }
+
   int64_t size() const
   {
     return max_ + 1;
   }
 private:
+  void init_count();
+
+  /// Count trailing zero bits, x > 0
+  static uint64_t ctz64(uint64_t x)
+  {
+    assert(x != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    uint64_t bits = 0;
+    for (; !(x & 1); x >>= 1)
+      bits++;
+    return bits;
+#endif
+  }
+
   struct PiData
   {
     uint64_t prime_count = 0;
@@ -0,0 +1,111 @@
+///
+/// @file  S2_easy_chunks.hpp
+/// @brief The number of easy special leaves of the b-th prime
+///        is very uneven: the first primes (near pi(sqrt(y)))
+///        have by far the most leaves. Hence processing the
+///        easy leaves one prime at a time does not scale as
+///        a single prime may dominate the computation. The
+///        easy leaves of the primes with many leaves are
+///        instead split into chunks of similar size:
+///        n = primes[b] * primes[l] with l_low < l <= l_high.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef S2_EASY_CHUNKS_HPP
+#define S2_EASY_CHUNKS_HPP
+
+#include <PiTable.hpp>
+#include <imath.hpp>
+#include <min.hpp>
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace primecount {
+
+struct S2EasyChunk
+{
+  int64_t b;
+  int64_t l_high;
+  int64_t l_low;
+};
+
+/// The easy leaves of the b-th prime are:
+/// n = primes[b] * primes[l] with l_low < l <= l_high
+///
+template <typename T, typename Primes>
+void S2_easy_range(T x,
+                   int64_t y,
+                   int64_t z,
+                   int64_t b,
+                   Primes& primes,
+                   const PiTable& pi,
+                   int64_t* l_high,
+                   int64_t* l_low)
+{
+  int64_t prime = primes[b];
+  T x2 = x / prime;
+  int64_t min_trivial = min(x2 / prime, y);
+  int64_t min_sparse = z / prime;
+  min_sparse = in_between(prime, min_sparse, y);
+
+  *l_high = pi[min_trivial];
+  *l_low = std::min(pi[min_sparse], *l_high);
+}
+
+/// Split the easy leaves of the primes b_start, b_start + step,
+/// b_start + 2 * step, ... <= b_end into chunks. Only the primes
+/// (at the beginning) that have more leaves than the chunk size
+/// are split, the other primes are processed one at a time.
+/// @return  The first prime that has not been split.
+///
+template <typename T, typename Primes>
+int64_t S2_easy_chunks(T x,
+                       int64_t y,
+                       int64_t z,
+                       int64_t b_start,
+                       int64_t b_end,
+                       int64_t step,
+                       int threads,
+                       Primes& primes,
+                       const PiTable& pi,
+                       std::vector<S2EasyChunk>& chunks)
+{
+  int64_t l_high = 0;
+  int64_t l_low = 0;
+  int64_t leaves = 0;
+
+  for (int64_t b = b_start; b <= b_end; b += step)
+  {
+    S2_easy_range(x, y, z, b, primes, pi, &l_high, &l_low);
+    leaves += l_high - l_low;
+  }
+
+  int64_t chunk_size = leaves / (threads * 64);
+  chunk_size = std::max(chunk_size, (int64_t) 1 << 12);
+  int64_t b = b_start;
+
+  for (; b <= b_end; b += step)
+  {
+    S2_easy_range(x, y, z, b, primes, pi, &l_high, &l_low);
+    if (l_high - l_low <= chunk_size)
+      break;
+
+    for (; l_high > l_low; l_high -= chunk_size)
+    {
+      int64_t low = std::max(l_high - chunk_size, l_low);
+      chunks.push_back({ b, l_high, low });
+    }
+  }
+
+  return b;
+}
+
+} // namespace
+
+#endif
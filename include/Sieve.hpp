@@ -13,7 +13,7 @@
 ///        elements that have been crossed off for the first
 ///        time in the sieve array.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -23,6 +23,7 @@
 #define SIEVE_HPP
 
 #include <stdint.h>
+#include <cstddef>
 #include <vector>
 
 namespace primecount {
@@ -43,6 +44,26 @@ struct Wheel
   uint32_t index;
 };
 
+/// Sieving primes > segment_size have at most one multiple
+/// per segment and most segments contain no multiple of
+/// such a prime at all. Hence these primes are stored in
+/// buckets (one bucket per segment), the bucket of each
+/// prime corresponds to the segment of its next multiple.
+///
+struct BucketPrime
+{
+  BucketPrime() = default;
+  BucketPrime(uint64_t m, uint32_t idx, uint32_t i)
+    : multiple(m),
+      index(idx),
+      prime_index(i)
+  { }
+  /// Byte offset of the next multiple (relative to start_)
+  uint64_t multiple;
+  uint32_t index;
+  uint32_t prime_index;
+};
+
 class Sieve
 {
 public:
@@ -87,10 +108,27 @@ public:
 private:
   void set_sieve_size(uint64_t segment_size);
   void add_wheel(uint64_t prime);
+  void copy_pattern(const std::vector<byte_t>& pattern, uint64_t offset, bool is_and);
+  void load_bucket(uint64_t segment);
+  void push_bucket(const BucketPrime& bucketPrime);
+  void resize_buckets(uint64_t prime);
+  uint64_t cross_off_bucket(uint64_t i, uint64_t prime);
 
   uint64_t start_;
   std::vector<byte_t> sieve_;
   std::vector<Wheel> wheel_;
+  /// Sieving primes >= bucket_limit_ are stored in buckets
+  uint64_t bucket_limit_;
+  /// Sieve size (in bytes) of a full segment
+  uint64_t bucket_sieve_size_;
+  /// Current segment number
+  uint64_t segment_;
+  /// Sieving primes with a multiple in the current
+  /// segment, sorted by their prime index.
+  std::vector<BucketPrime> bucket_;
+  std::size_t bucket_pos_;
+  /// Ring buffer of buckets, buckets_[segment % size]
+  std::vector<std::vector<BucketPrime>> buckets_;
 };
 
 } // namespace
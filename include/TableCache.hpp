@@ -0,0 +1,63 @@
+///
+/// @file  TableCache.hpp
+/// @brief LRU cache of the lookup tables (primes, PiTable,
+///        FactorTable) of the most recently used values of y.
+///        By default the cache is disabled and each call of
+///        pi(x) builds its tables from scratch. primecount
+///        --serve enables the cache so that repeated queries
+///        with the same y (e.g. the same x with a different
+///        number of threads) skip the table construction.
+///
+///        The tables are returned as std::shared_ptr<const T>
+///        hence a table evicted from the cache stays alive
+///        until the last computation using it has finished.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef TABLECACHE_HPP
+#define TABLECACHE_HPP
+
+#include <stdint.h>
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+
+namespace primecount {
+
+/// Keep the tables of up to size values of y,
+/// size = 0 disables the cache (default).
+///
+void set_table_cache_size(int size);
+int get_table_cache_size();
+
+/// Returns nullptr if the table is not cached
+std::shared_ptr<const void> find_table(int64_t y, std::type_index type, int64_t limit);
+
+void insert_table(int64_t y, std::type_index type, int64_t limit, std::shared_ptr<const void> table);
+
+/// Get the table of type T with the given limit for
+/// y from the cache, or create it using create() and
+/// insert it into the cache.
+///
+template <typename T, typename F>
+std::shared_ptr<const T> get_table(int64_t y, int64_t limit, F create)
+{
+  if (get_table_cache_size() <= 0)
+    return std::make_shared<const T>(create());
+
+  auto table = find_table(y, typeid(T), limit);
+  if (table)
+    return std::static_pointer_cast<const T>(table);
+
+  auto new_table = std::make_shared<const T>(create());
+  insert_table(y, typeid(T), limit, new_table);
+  return new_table;
+}
+
+} // namespace
+
+#endif
@@ -10,8 +10,8 @@
 ///        to my implementation which significantly speed up the
 ///        calculation:
 ///
-///        * Cache results of phi(x, a)
-///        * Calculate phi(x, a) using formula [2] if a <= 6
+///        * Lookup phi(x, a) results of small x in PhiTable
+///        * Calculate phi(x, a) using formula [2] if a <= 8
 ///        * Calculate phi(x, a) using pi(x) lookup table
 ///        * Calculate all phi(x, a) = 1 upfront
 ///        * Stop recursion at c instead of 1
@@ -22,7 +22,7 @@
 ///       [2] phi(x, a) = (x / pp) * φ(pp) + phi(x % pp, a)
 ///           with pp = 2 * 3 * ... * prime[a] 
 ///
-/// Copyright (C) 2017 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -34,29 +34,26 @@
 #include <primecount-internal.hpp>
 #include <fast_div.hpp>
 #include <imath.hpp>
+#include <PhiTable.hpp>
 #include <PhiTiny.hpp>
 #include <PiTable.hpp>
 
 #include <stdint.h>
-#include <array>
 #include <vector>
-#include <limits>
 
 namespace {
 
 using namespace std;
 using namespace primecount;
 
-/// Cache phi(x, a) results if a < MAX_A
-const int MAX_A = 100;
-
 template <typename Primes>
 class PhiCache
 {
 public:
-  PhiCache(Primes& primes, PiTable& pi)
+  PhiCache(Primes& primes, const PiTable& pi)
     : primes_(primes),
-      pi_(pi)
+      pi_(pi),
+      phiTable_(get_phi_table())
   { }
 
   /// Calculate phi(x, a) using the recursive formula:
@@ -71,8 +68,8 @@ public:
       return phi_tiny(x, a) * SIGN;
     else if (is_pix(x, a))
       return (pi_[x] - a + 1) * SIGN;
-    else if (is_cached(x, a))
-      return cache_[a][x] * SIGN;
+    else if (phiTable_.is_cached(x, a))
+      return phiTable_.phi(x, a) * SIGN;
 
     int64_t sqrtx = isqrt(x);
     int64_t pi_sqrtx = a;
@@ -103,46 +100,24 @@ public:
         sum += phi<-SIGN>(x2, i);
     }
 
-    update_cache(x, a, sum);
-
     return sum;
   }
 
 private:
-  using T = uint16_t;
-  array<vector<T>, MAX_A> cache_;
   Primes& primes_;
-  PiTable& pi_;
+  const PiTable& pi_;
+  const PhiTable& phiTable_;
 
   int64_t prime(int64_t i) const
   {
     return primes_[i];
   }
 
-  void update_cache(uint64_t x, uint64_t a, int64_t sum)
-  {
-    if (a < cache_.size() &&
-        x <= numeric_limits<T>::max())
-    {
-      if (x >= cache_[a].size())
-        cache_[a].resize(x + 1, 0);
-
-      cache_[a][x] = (T) abs(sum);
-    }
-  }
-
   bool is_pix(int64_t x, int64_t a) const
   {
     return x < pi_.size() &&
            x < isquare(prime(a + 1));
   }
-
-  bool is_cached(uint64_t x, uint64_t a) const
-  {
-    return a < cache_.size() && 
-           x < cache_[a].size() && 
-           cache_[a][x];
-  }
 };
 
 /// Returns a vector with phi(x, i - 1) values such that
@@ -151,7 +126,7 @@ private:
 /// divisible by any of the first a primes.
 ///
 template <typename Primes>
-vector<int64_t> generate_phi(int64_t x, int64_t a, Primes& primes, PiTable& pi)
+vector<int64_t> generate_phi(int64_t x, int64_t a, Primes& primes, const PiTable& pi)
 {
   int64_t size = a + 1;
 
@@ -0,0 +1,53 @@
+///
+/// @file  multiarch.hpp
+/// @brief When primecount is built with WITH_MULTIARCH=ON the
+///        hot functions are compiled multiple times for
+///        different x86-64 ISA levels (x86-64-v2 = POPCNT,
+///        SSE4.2; x86-64-v3 = AVX2, BMI2; x86-64-v4 = AVX512)
+///        and the best version is selected at startup using
+///        CPUID. This way a portable primecount binary still
+///        runs at full speed on recent CPUs.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#ifndef MULTIARCH_HPP
+#define MULTIARCH_HPP
+
+#if defined(ENABLE_MULTIARCH)
+  #define MULTIARCH_TARGET_CLONES \
+    __attribute__((target_clones("default", "arch=x86-64-v2", "arch=x86-64-v3", "arch=x86-64-v4")))
+#else
+  #define MULTIARCH_TARGET_CLONES
+#endif
+
+namespace primecount {
+
+/// Returns the ISA level of the code path selected
+/// at startup or an empty string if primecount has
+/// been built without WITH_MULTIARCH.
+///
+inline const char* multiarch_level()
+{
+#if defined(ENABLE_MULTIARCH)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("x86-64-v4"))
+    return "x86-64-v4";
+  if (__builtin_cpu_supports("x86-64-v3"))
+    return "x86-64-v3";
+  if (__builtin_cpu_supports("x86-64-v2"))
+    return "x86-64-v2";
+
+  return "x86-64";
+#else
+  return "";
+#endif
+}
+
+} // namespace
+
+#endif
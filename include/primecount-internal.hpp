@@ -81,6 +81,10 @@ int64_t pi_meissel(int64_t x, int threads);
 
 int64_t phi(int64_t x, int64_t a, int threads);
 
+void set_phi_cache_size(int64_t bytes);
+
+int64_t get_phi_cache_size();
+
 int64_t Li(int64_t);
 
 int64_t Li_inverse(int64_t);
@@ -131,6 +135,30 @@ double get_alpha_lmo(maxint_t x);
 
 double get_alpha_deleglise_rivat(maxint_t x);
 
+void set_cache_size(int64_t bytes);
+
+void set_cache_level(int level);
+
+int64_t get_cache_size();
+
+/// Global settings, e.g. set using command-line options
+struct Settings
+{
+  int threads;
+  double alpha;
+  int64_t cache_size;
+  int cache_level;
+  int64_t phi_cache_size;
+  std::string affinity;
+  int status_precision;
+  bool print;
+  bool print_variables;
+};
+
+Settings get_settings();
+
+void set_settings(const Settings& settings);
+
 double get_time();
 
 int ideal_num_threads(int threads, int64_t sieve_limit, int64_t thread_threshold = 100000);
@@ -0,0 +1,478 @@
+///
+/// @file  CpuAffinity.cpp
+/// @see   CpuAffinity.hpp for documentation
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <CpuAffinity.hpp>
+#include <primecount.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <stdint.h>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#if defined(__linux__)
+  #include <sched.h>
+#endif
+
+using namespace std;
+using namespace primecount;
+
+namespace {
+
+unique_ptr<CpuAffinity> affinity_;
+string affinity_str_;
+
+/// Incremented each time the affinity is changed,
+/// threads which have been pinned using an older
+/// generation need to be pinned (or unpinned) again.
+///
+int generation_ = 0;
+
+/// Generation and thread number the calling thread
+/// has last been pinned (or unpinned) with.
+///
+thread_local int bound_generation_ = -1;
+thread_local int bound_thread_num_ = -1;
+thread_local bool is_pinned_ = false;
+
+#if defined(__linux__)
+
+/// The CPU affinity of the process before the first
+/// call of set_affinity(). Pinned threads are reset
+/// to this mask when thread pinning is disabled or
+/// before they are pinned using a new affinity.
+///
+cpu_set_t process_mask_;
+bool has_process_mask_ = false;
+
+void save_process_mask()
+{
+  if (has_process_mask_)
+    return;
+
+  CPU_ZERO(&process_mask_);
+  if (sched_getaffinity(0, sizeof(process_mask_), &process_mask_) != 0)
+    throw primecount_error("failed to read the process CPU affinity");
+
+  has_process_mask_ = true;
+}
+
+/// Unpin the calling thread
+void restore_process_mask()
+{
+  if (has_process_mask_)
+    sched_setaffinity(0, sizeof(process_mask_), &process_mask_);
+}
+
+const int max_cpus = CPU_SETSIZE;
+
+#else
+
+void save_process_mask() { }
+void restore_process_mask() { }
+
+const int max_cpus = 1 << 16;
+
+#endif
+
+int get_thread_num()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+string trim(const string& str)
+{
+  string s = str;
+  s.erase(remove_if(s.begin(), s.end(), [](char c) { return isspace((unsigned char) c); }), s.end());
+  return s;
+}
+
+/// Parse a CPU list e.g. "0,2,4-7".
+/// Throws an exception on invalid input.
+///
+vector<int> parse_cpu_list(const string& str)
+{
+  vector<int> cpus;
+  string list = trim(str);
+  istringstream iss(list);
+  string range;
+
+  if (list.empty())
+    throw primecount_error("invalid cpu list: " + str);
+
+  while (getline(iss, range, ','))
+  {
+    auto pos = range.find('-');
+    string first = range.substr(0, pos);
+    string last = (pos == string::npos) ? first : range.substr(pos + 1);
+
+    if (first.empty() ||
+        last.empty() ||
+        first.find_first_not_of("0123456789") != string::npos ||
+        last.find_first_not_of("0123456789") != string::npos)
+      throw primecount_error("invalid cpu list: " + str);
+
+    // Check the CPU IDs before expanding the range,
+    // long numbers would overflow stoi().
+    if (first.size() > 9 ||
+        last.size() > 9 ||
+        stoi(last) >= max_cpus)
+      throw primecount_error("invalid cpu list: " + str + ", cpu ids must be < " + to_string(max_cpus));
+
+    int a = stoi(first);
+    int b = stoi(last);
+
+    if (a > b)
+      throw primecount_error("invalid cpu list: " + str);
+
+    for (int i = a; i <= b; i++)
+      cpus.push_back(i);
+  }
+
+  return cpus;
+}
+
+#if defined(__linux__)
+
+string read_file(const string& filename)
+{
+  ifstream file(filename);
+  string str;
+  if (file)
+    getline(file, str);
+  return trim(str);
+}
+
+int read_int(const string& filename, int default_value)
+{
+  string str = read_file(filename);
+  if (str.empty() || str.find_first_not_of("0123456789") != string::npos)
+    return default_value;
+  return stoi(str);
+}
+
+/// Parse a cache size e.g. "48K"
+int64_t read_cache_size(const string& filename)
+{
+  string str = read_file(filename);
+  if (str.empty() || !isdigit((unsigned char) str[0]))
+    return 0;
+
+  size_t pos = 0;
+  int64_t size = stoll(str, &pos);
+  string unit = str.substr(pos);
+
+  if (unit == "K")
+    size <<= 10;
+  if (unit == "M")
+    size <<= 20;
+  if (unit == "G")
+    size <<= 30;
+
+  return size;
+}
+
+/// Read the CPU topology from /sys/devices/system/cpu.
+/// Only the CPU cores the process was allowed to run on
+/// before the first call of set_affinity() are returned.
+/// The calling thread's own mask cannot be used as it may
+/// already have been pinned to a single CPU core.
+///
+vector<CpuAffinity::Cpu> get_cpus()
+{
+  vector<CpuAffinity::Cpu> cpus;
+  string path = "/sys/devices/system/cpu/";
+  string online = read_file(path + "online");
+  if (online.empty())
+    throw primecount_error("failed to read the CPU topology");
+
+  save_process_mask();
+
+  for (int id : parse_cpu_list(online))
+  {
+    if (!CPU_ISSET(id, &process_mask_))
+      continue;
+
+    CpuAffinity::Cpu cpu;
+    string cpu_path = path + "cpu" + to_string(id) + "/";
+    cpu.id = id;
+    cpu.package = read_int(cpu_path + "topology/physical_package_id", 0);
+    cpu.core = read_int(cpu_path + "topology/core_id", id);
+    cpu.l2_domain = id;
+
+    for (int i = 0; i <= 4; i++)
+    {
+      string cache = cpu_path + "cache/index" + to_string(i) + "/";
+      int level = read_int(cache + "level", 0);
+      string type = read_file(cache + "type");
+      int64_t size = read_cache_size(cache + "size");
+
+      if (level == 1 && type == "Data")
+        cpu.l1_cache_size = size;
+      if (level == 2 && type != "Instruction")
+      {
+        cpu.l2_cache_size = size;
+        string shared = read_file(cache + "shared_cpu_list");
+        if (!shared.empty())
+          cpu.l2_domain = parse_cpu_list(shared).front();
+      }
+    }
+
+    cpus.push_back(cpu);
+  }
+
+  if (cpus.empty())
+    throw primecount_error("failed to read the CPU topology");
+
+  return cpus;
+}
+
+/// Threads are placed onto the hyper-threads of the same
+/// CPU core first, then onto the CPU cores sharing the
+/// same L2 cache, then onto the same CPU socket.
+///
+void sort_compact(vector<CpuAffinity::Cpu>& cpus)
+{
+  sort(cpus.begin(), cpus.end(),
+       [](const CpuAffinity::Cpu& a, const CpuAffinity::Cpu& b) {
+         return tie(a.package, a.l2_domain, a.core, a.id) <
+                tie(b.package, b.l2_domain, b.core, b.id);
+       });
+}
+
+/// Threads are distributed round-robin across the CPU
+/// sockets and L2 cache domains. Within an L2 cache domain
+/// the physical CPU cores are used before their
+/// hyper-threads.
+///
+void sort_scatter(vector<CpuAffinity::Cpu>& cpus)
+{
+  sort_compact(cpus);
+  size_t n = cpus.size();
+  vector<int> smt(n, 0);
+  vector<int> rank(n, 0);
+  vector<int> domain(n, 0);
+
+  // smt = hyper-thread index within its CPU core
+  for (size_t i = 1; i < n; i++)
+    if (cpus[i].package == cpus[i - 1].package &&
+        cpus[i].core == cpus[i - 1].core)
+      smt[i] = smt[i - 1] + 1;
+
+  // domain = index of the L2 domain within its socket
+  for (size_t i = 1; i < n; i++)
+  {
+    if (cpus[i].package != cpus[i - 1].package)
+      domain[i] = 0;
+    else if (cpus[i].l2_domain != cpus[i - 1].l2_domain)
+      domain[i] = domain[i - 1] + 1;
+    else
+      domain[i] = domain[i - 1];
+  }
+
+  // rank = index within its L2 domain,
+  // physical CPU cores first
+  vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++)
+    order[i] = i;
+
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return tie(cpus[a].package, cpus[a].l2_domain, smt[a]) <
+           tie(cpus[b].package, cpus[b].l2_domain, smt[b]);
+  });
+
+  for (size_t i = 1; i < n; i++)
+  {
+    size_t a = order[i - 1];
+    size_t b = order[i];
+    if (cpus[a].package == cpus[b].package &&
+        cpus[a].l2_domain == cpus[b].l2_domain)
+      rank[b] = rank[a] + 1;
+  }
+
+  for (size_t i = 0; i < n; i++)
+    order[i] = i;
+
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return tie(rank[a], domain[a], cpus[a].package) <
+           tie(rank[b], domain[b], cpus[b].package);
+  });
+
+  vector<CpuAffinity::Cpu> sorted;
+  for (size_t i : order)
+    sorted.push_back(cpus[i]);
+
+  cpus = sorted;
+}
+
+#endif
+
+} // namespace
+
+namespace primecount {
+
+CpuAffinity::CpuAffinity(const string& affinity)
+{
+#if defined(__linux__)
+  auto cpus = get_cpus();
+
+  if (affinity == "compact")
+    sort_compact(cpus);
+  else if (affinity == "scatter")
+    sort_scatter(cpus);
+  else
+  {
+    vector<Cpu> list;
+    for (int id : parse_cpu_list(affinity))
+    {
+      auto iter = find_if(cpus.begin(), cpus.end(),
+                          [&](const Cpu& cpu) { return cpu.id == id; });
+      if (iter == cpus.end())
+        throw primecount_error("cpu " + to_string(id) + " is not available");
+      list.push_back(*iter);
+    }
+    cpus = list;
+  }
+
+  cpus_ = cpus;
+#else
+  throw primecount_error("--affinity=" + affinity + " is only supported on Linux");
+#endif
+}
+
+/// Thread i is pinned to cpus_[i % cpus_.size()]
+const CpuAffinity::Cpu& CpuAffinity::get_cpu(int thread_num) const
+{
+  return cpus_[thread_num % cpus_.size()];
+}
+
+void CpuAffinity::bind_thread(int thread_num) const
+{
+#if defined(__linux__)
+  int id = get_cpu(thread_num).id;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(id, &mask);
+
+  // pid = 0 refers to the calling thread
+  sched_setaffinity(0, sizeof(mask), &mask);
+#else
+  (void) thread_num;
+#endif
+}
+
+int64_t CpuAffinity::l1_cache_size(int thread_num) const
+{
+  return get_cpu(thread_num).l1_cache_size;
+}
+
+int64_t CpuAffinity::l2_cache_size(int thread_num) const
+{
+  return get_cpu(thread_num).l2_cache_size;
+}
+
+int64_t CpuAffinity::max_l1_cache_size() const
+{
+  int64_t size = 0;
+  for (auto& cpu : cpus_)
+    size = max(size, cpu.l1_cache_size);
+  return size;
+}
+
+int64_t CpuAffinity::max_l2_cache_size() const
+{
+  int64_t size = 0;
+  for (auto& cpu : cpus_)
+    size = max(size, cpu.l2_cache_size);
+  return size;
+}
+
+void set_affinity(const string& affinity)
+{
+  save_process_mask();
+
+  if (affinity.empty() || affinity == "none")
+    affinity_.reset();
+  else
+    affinity_.reset(new CpuAffinity(affinity));
+
+  // The calling thread is OpenMP thread 0 of the next
+  // parallel region, unpin it right away. The other
+  // threads are unpinned (or pinned again) by
+  // bind_thread() in the next parallel region.
+  restore_process_mask();
+  is_pinned_ = false;
+  affinity_str_ = affinity;
+  generation_++;
+}
+
+string get_affinity()
+{
+  return affinity_str_;
+}
+
+bool is_affinity()
+{
+  return affinity_ != nullptr;
+}
+
+void bind_thread()
+{
+  if (!affinity_ && !is_pinned_)
+    return;
+
+  // OpenMP reuses its threads across parallel
+  // regions, hence each thread needs to be
+  // pinned only once.
+  int thread_num = get_thread_num();
+
+  if (bound_generation_ != generation_ ||
+      bound_thread_num_ != thread_num)
+  {
+    // Thread pinning has been disabled after
+    // this thread was pinned
+    if (!affinity_)
+      restore_process_mask();
+    else
+      affinity_->bind_thread(thread_num);
+
+    is_pinned_ = (affinity_ != nullptr);
+    bound_generation_ = generation_;
+    bound_thread_num_ = thread_num;
+  }
+}
+
+int64_t thread_l1_cache_size()
+{
+  if (!affinity_)
+    return 0;
+  return affinity_->l1_cache_size(get_thread_num());
+}
+
+int64_t thread_l2_cache_size()
+{
+  if (!affinity_)
+    return 0;
+  return affinity_->l2_cache_size(get_thread_num());
+}
+
+} // namespace
@@ -1,72 +1,215 @@
 ///
 /// @file  Li.cpp
-/// @brief Logarithmic integral and Riemann R functions
+/// @brief Logarithmic integral and Riemann R functions.
+///        If the compiler supports __float128 (libquadmath)
+///        the computations use quadruple precision (113 bits)
+///        so that the results are accurate for x up to 10^30
+///        and beyond, else long double precision is used.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <primecount-internal.hpp>
-#include <generate.hpp>
 #include <int128_t.hpp>
 
 #include <stdint.h>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <limits>
 
+#if defined(HAVE_FLOAT128)
+  #include <quadmath.h>
+#endif
+
 using namespace std;
 
+namespace {
+
+#if defined(HAVE_FLOAT128)
+
+typedef __float128 real_t;
+
+real_t real_log(real_t x) { return logq(x); }
+real_t real_sqrt(real_t x) { return sqrtq(x); }
+real_t real_abs(real_t x) { return fabsq(x); }
+// 2^-112, FLT128_EPSILON uses the non-standard Q suffix
+real_t real_epsilon() { return ldexpq(1, -112); }
+real_t real_parse(const char* str) { return strtoflt128(str, nullptr); }
+
+#else
+
+typedef long double real_t;
+
+real_t real_log(real_t x) { return log(x); }
+real_t real_sqrt(real_t x) { return sqrt(x); }
+real_t real_abs(real_t x) { return abs(x); }
+real_t real_epsilon() { return numeric_limits<long double>::epsilon(); }
+real_t real_parse(const char* str) { return strtold(str, nullptr); }
+
+#endif
+
+/// Euler-Mascheroni constant and li(2), the floating
+/// point literals of C++ are at most long double.
+const real_t euler_gamma = real_parse("0.5772156649015328606065120900824024310422");
+const real_t li2 = real_parse("1.045163780117492784844588889194613136522615");
+
+/// zeta[s] = zeta(s) for 2 <= s < 128, computed using
+/// Borwein's algorithm 2 (with n = 50 the error is < 10^-37):
+/// http://numbers.computation.free.fr/Constants/Miscellaneous/zetaevaluations.pdf
+///
+class ZetaTable
+{
+public:
+  ZetaTable()
+  {
+    const int n = 50;
+    array<real_t, n + 1> d;
+    array<real_t, n> pow_k;
+    real_t term = 1;
+    real_t sum = 1;
+    d[0] = 1;
+
+    // d[k] = n * sum_{i=0}^{k} (n+i-1)! * 4^i / ((n-i)! * (2i)!)
+    for (int i = 1; i <= n; i++)
+    {
+      term *= (real_t) 4 * (n + i - 1) * (n - i + 1) /
+              ((real_t) (2 * i) * (2 * i - 1));
+      sum += term;
+      d[i] = sum;
+    }
+
+    // pow_k[k] = (k + 1)^-s
+    for (int k = 0; k < n; k++)
+      pow_k[k] = 1 / (real_t) (k + 1);
+
+    real_t pow2 = 1;
+    zeta_[0] = 0;
+    zeta_[1] = 0;
+
+    for (int s = 2; s < size(); s++)
+    {
+      real_t eta = 0;
+      for (int k = 0; k < n; k++)
+      {
+        pow_k[k] /= (k + 1);
+        real_t t = (d[k] - d[n]) * pow_k[k];
+        eta += (k % 2) ? -t : t;
+      }
+
+      // zeta(s) = eta(s) / (1 - 2^(1-s))
+      pow2 /= 2;
+      eta = -eta / d[n];
+      zeta_[s] = eta / (1 - pow2);
+    }
+  }
+
+  static int size()
+  {
+    return 128;
+  }
+
+  /// For s >= 128: zeta(s) - 1 < 2^-127
+  /// which is below quadruple precision.
+  ///
+  real_t operator[](int s) const
+  {
+    assert(s >= 2);
+    if (s < size())
+      return zeta_[s];
+    else
+      return 1;
+  }
+
+private:
+  array<real_t, 128> zeta_;
+};
+
+/// Calculate the logarithmic integral using the asymptotic
+/// expansion li(x) ~ x / log(x) * sum_{k >= 0} k! / log(x)^k.
+/// The series diverges, its terms decrease until k ~ log(x)
+/// hence it can only be used for very large x.
+/// @return  false if the expansion does not reach the
+///          precision of real_t.
+///
+bool li_asymptotic(real_t x, real_t logx, real_t* res)
+{
+  real_t eps = real_epsilon();
+  real_t sum = 1;
+  real_t term = 1;
+
+  for (int k = 1; k < logx; k++)
+  {
+    term *= k / logx;
+    sum += term;
+    if (term < eps * sum)
+    {
+      *res = x / logx * sum;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace
+
 namespace primecount {
 
 /// Calculate the logarithmic integral using
 /// Ramanujan's formula:
 /// https://en.wikipedia.org/wiki/Logarithmic_integral_function#Series_representation
 ///
-long double li(long double x)
+real_t li(real_t x)
 {
   assert(x >= 2);
 
-  long double gamma = 0.57721566490153286061;
-  long double sum = 0;
-  long double inner_sum = 0;
-  long double factorial = 1;
-  long double p = -1;
-  long double q = 0;
-  long double power2 = 1;
-  long double term;
+  real_t logx = real_log(x);
+  real_t res;
+
+  // The asymptotic expansion converges much faster
+  // but it is only precise enough for log(x) >
+  // -log(epsilon) i.e. x > ~10^19 using long double
+  // and x > ~10^33 using __float128.
+  if (logx > -real_log(real_epsilon()) &&
+      li_asymptotic(x, logx, &res))
+    return res;
+
+  real_t eps = real_epsilon();
+  real_t sum = 0;
+  real_t inner_sum = 0;
+  real_t p = -2;
+  real_t term;
   int k = 0;
 
-  for (int n = 1; n < 200; n++)
+  // p = (-1)^(n-1) * log(x)^n / (n! * 2^(n-1))
+  for (int n = 1; n < 1000; n++)
   {
-    p *= -log(x);
-    factorial *= n;
-    q = factorial * power2;
-    power2 *= 2;
+    p *= -logx / (2 * n);
     for (; k <= (n - 1) / 2; k++)
-      inner_sum += 1.0L / (2 * k + 1);
-    term = (p / q) * inner_sum;
+      inner_sum += 1 / (real_t) (2 * k + 1);
+    term = p * inner_sum;
     sum += term;
-    if (abs(term) < numeric_limits<double>::epsilon())
+    if (real_abs(term) < eps)
       break;
   }
 
-  return gamma + log(log(x)) + sqrt(x) * sum;
+  return euler_gamma + real_log(logx) + real_sqrt(x) * sum;
 }
 
 /// Calculate the offset logarithmic integral which is a very
 /// accurate approximation of the number of primes <= x.
 /// Li(x) > pi(x) for 24 <= x <= ~ 10^316
 ///
-long double Li(long double x)
+real_t Li(real_t x)
 {
   if (x < 2)
     return 0;
 
-  long double li2 = 1.04516378011749278484;
-
   return li(x) - li2;
 }
 
@@ -74,20 +217,20 @@ long double Li(long double x)
 /// is a very accurate approximation of the nth prime.
 /// Li^-1(x) < nth_prime(x) for 7 <= x <= 10^316
 ///
-long double Li_inverse(long double x)
+real_t Li_inverse(real_t x)
 {
   if (x < 2)
     return 0;
 
-  long double t = x * log(x);
-  long double old_term = numeric_limits<long double>::infinity();
+  real_t t = x * real_log(x);
+  real_t old_term = 1 / (real_t) 0;
 
   for (int i = 0; i < 100; i++)
   {
-    long double term = (Li(t) - x) * log(t);
+    real_t term = (Li(t) - x) * real_log(t);
     t -= term;
     // not converging anymore
-    if (abs(term) >= abs(old_term))
+    if (real_abs(term) >= real_abs(old_term))
       break;
     old_term = term;
   }
@@ -96,29 +239,29 @@ long double Li_inverse(long double x)
 }
 
 /// Calculate the Riemann R function which is a very accurate
-/// approximation of the number of primes below x.
+/// approximation of the number of primes below x using the
+/// Gram series (all of its terms are positive):
+/// R(x) = 1 + sum_{k=1}^{inf} log(x)^k / (k * k! * zeta(k + 1))
 ///
-long double Ri(long double x)
+real_t Ri(real_t x)
 {
   if (x < 2)
     return 0;
 
-  int terms = 200;
-  auto mu = generate_moebius(terms);
-  long double sum = 0;
-  long double root;
-  long double term;
+  static const ZetaTable zeta;
+  real_t eps = real_epsilon();
+  real_t logx = real_log(x);
+  real_t sum = 1;
+  real_t p = 1;
 
-  for (int n = 1; n < terms; n++)
+  // p = log(x)^k / k!
+  for (int k = 1; k < 100000; k++)
   {
-    if (mu[n])
-    {
-      root = pow(x, 1.0L / n);
-      term = (Li(root) * mu[n]) / n;
-      sum += term;
-      if (abs(term) < numeric_limits<double>::epsilon())
-        break;
-    }
+    p *= logx / k;
+    real_t term = p / (k * zeta[k + 1]);
+    sum += term;
+    if (term < eps * sum)
+      break;
   }
 
   return sum;
@@ -127,20 +270,20 @@ long double Ri(long double x)
 /// Calculate the inverse Riemann R function which is a very
 /// accurate approximation of the nth prime.
 ///
-long double Ri_inverse(long double x)
+real_t Ri_inverse(real_t x)
 {
   if (x < 2)
     return 0;
 
-  long double t = Li_inverse(x);
-  long double old_term = numeric_limits<long double>::infinity();
+  real_t t = Li_inverse(x);
+  real_t old_term = 1 / (real_t) 0;
 
   for (int i = 0; i < 100; i++)
   {
-    long double term = (Ri(t) - x) * log(t);
+    real_t term = (Ri(t) - x) * real_log(t);
     t -= term;
     // not converging anymore
-    if (abs(term) >= abs(old_term))
+    if (real_abs(term) >= real_abs(old_term))
       break;
     old_term = term;
   }
@@ -150,48 +293,48 @@ long double Ri_inverse(long double x)
 
 int64_t Li(int64_t x)
 {
-  return (int64_t) Li((long double) x);
+  return (int64_t) Li((real_t) x);
 }
 
 int64_t Li_inverse(int64_t x)
 {
-  return (int64_t) Li_inverse((long double) x);
+  return (int64_t) Li_inverse((real_t) x);
 }
 
 #ifdef HAVE_INT128_T
 
 int128_t Li(int128_t x)
 {
-  return (int128_t) Li((long double) x);
+  return (int128_t) Li((real_t) x);
 }
 
 int128_t Li_inverse(int128_t x)
 {
-  return (int128_t) Li_inverse((long double) x);
+  return (int128_t) Li_inverse((real_t) x);
 }
 
 #endif
 
 int64_t Ri(int64_t x)
 {
-  return (int64_t) Ri((long double) x);
+  return (int64_t) Ri((real_t) x);
 }
 
 int64_t Ri_inverse(int64_t x)
 {
-  return (int64_t) Ri_inverse((long double) x);
+  return (int64_t) Ri_inverse((real_t) x);
 }
 
 #ifdef HAVE_INT128_T
 
 int128_t Ri(int128_t x)
 {
-  return (int128_t) Ri((long double) x);
+  return (int128_t) Ri((real_t) x);
 }
 
 int128_t Ri_inverse(int128_t x)
 {
-  return (int128_t) Ri_inverse((long double) x);
+  return (int128_t) Ri_inverse((real_t) x);
 }
 
 #endif
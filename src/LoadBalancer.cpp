@@ -21,7 +21,7 @@
 ///        order to prevent that 1 thread will run much longer
 ///        than all the other threads.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -30,6 +30,7 @@
 #include <LoadBalancer.hpp>
 #include <primecount-internal.hpp>
 #include <S2Status.hpp>
+#include <CpuAffinity.hpp>
 #include <Sieve.hpp>
 #include <imath.hpp>
 #include <int128_t.hpp>
@@ -78,9 +79,8 @@ void LoadBalancer::init_size()
   segment_size_ = Sieve::get_segment_size(segment_size_);
 
   // try to use a segment size that fits exactly
-  // into the CPUs L1 data cache
-  int64_t l1_dcache_size = 1 << 15;
-  max_size_ = l1_dcache_size * 30;
+  // into the CPUs L1 (or L2) cache
+  max_size_ = get_cache_size() * 30;
   max_size_ = max(max_size_, sqrtz);
   max_size_ = Sieve::get_segment_size(max_size_);
 }
@@ -96,6 +96,16 @@ bool LoadBalancer::get_work(int64_t* low,
                             maxint_t s2,
                             Runtime& runtime)
 {
+  // if the threads are pinned to CPU cores we know
+  // the cache size of the calling thread
+  int64_t thread_max_size = max_size_;
+
+  if (is_affinity())
+  {
+    thread_max_size = max(get_cache_size() * 30, isqrt(z_));
+    thread_max_size = Sieve::get_segment_size(thread_max_size);
+  }
+
   #pragma omp critical (get_work)
   {
     s2_total_ += s2;
@@ -104,9 +114,18 @@ bool LoadBalancer::get_work(int64_t* low,
 
     *low = low_;
     *segments = segments_;
-    *segment_size = segment_size_;
 
-    low_ += segments_ * segment_size_;
+    // While the segment size is ramping up all threads
+    // use the same segment size (capped to their cache).
+    // Once it has reached the maximum each thread uses
+    // a segment size that fits into its own cache, so
+    // that a core with a larger cache gets more work.
+    if (segment_size_ < max_size_)
+      *segment_size = min(segment_size_, thread_max_size);
+    else
+      *segment_size = thread_max_size;
+
+    low_ += segments_ * *segment_size;
 
     if (is_print())
       status_.print(s2_total_, s2_approx_);
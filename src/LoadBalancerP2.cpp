@@ -0,0 +1,95 @@
+///
+/// @file  LoadBalancerP2.cpp
+/// @brief The LoadBalancerP2 assigns work to the individual
+///        threads in the computation of the 2nd partial sieve
+///        function P2(x, a). Each thread requests a work unit
+///        i.e. an interval [low, high[ whenever it is idle, the
+///        size of the work units decreases as the computation
+///        proceeds (guided scheduling) so that all threads
+///        finish at about the same time.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <LoadBalancerP2.hpp>
+#include <primecount-internal.hpp>
+#include <imath.hpp>
+#include <int128_t.hpp>
+#include <min.hpp>
+#include <print.hpp>
+
+#include <stdint.h>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+namespace primecount {
+
+LoadBalancerP2::LoadBalancerP2(maxint_t x,
+                               int64_t low,
+                               int64_t z,
+                               int threads) :
+  low_(low),
+  start_(low),
+  z_(z)
+{
+  // Each work unit initializes the sieving primes
+  // <= sqrt(z), hence a work unit must be
+  // much larger than sqrt(z).
+  min_dist_ = 1 << 22;
+  min_dist_ = max(min_dist_, isqrt(z) * 4);
+
+  int64_t max_threads = ceil_div(z - low, min_dist_);
+  threads_ = in_between(1, threads, max_threads);
+  precision_ = get_status_precision(x);
+}
+
+int LoadBalancerP2::get_threads() const
+{
+  return threads_;
+}
+
+/// Assign the next work unit [low, high[ to the
+/// calling thread. Returns false once the
+/// entire interval has been assigned.
+///
+bool LoadBalancerP2::get_work(int64_t* low, int64_t* high)
+{
+  bool is_work = false;
+
+  #pragma omp critical (LoadBalancerP2)
+  {
+    if (low_ < z_)
+    {
+      int64_t dist = (z_ - low_) / (threads_ * 4);
+      dist = max(dist, min_dist_);
+
+      // low must be a multiple of 30
+      // for the Sieve class
+      dist = ceil_div(dist, 30) * 30;
+
+      *low = low_;
+      *high = min(low_ + dist, z_);
+      low_ = *high;
+      is_work = true;
+    }
+
+    if (is_print())
+      print_status();
+  }
+
+  return is_work;
+}
+
+void LoadBalancerP2::print_status() const
+{
+  double percent = get_percent(low_ - start_, z_ - start_);
+  cout << "\rStatus: " << fixed << setprecision(precision_)
+       << percent << '%' << flush;
+}
+
+} // namespace
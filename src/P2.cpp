@@ -4,102 +4,116 @@
 ///        numbers <= x that have exactly 2 prime factors
 ///        each exceeding the a-th prime.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
+#include <LoadBalancerP2.hpp>
+#include <PiTable.hpp>
+#include <Sieve.hpp>
 #include <primesieve.hpp>
-#include <aligned_vector.hpp>
+#include <fast_div.hpp>
+#include <generate.hpp>
 #include <int128_t.hpp>
 #include <min.hpp>
 #include <imath.hpp>
+#include <multiarch.hpp>
 #include <print.hpp>
 
 #include <stdint.h>
 #include <algorithm>
-#include <iostream>
-#include <iomanip>
+#include <vector>
 
 using namespace std;
 using namespace primecount;
 
 namespace {
 
-/// Count the primes inside [prime, stop]
 template <typename T>
-int64_t count_primes(primesieve::iterator& it, int64_t& prime, T stop)
+struct P2Work
 {
-  int64_t count = 0;
+  int64_t low;
+  T p2;
+  int64_t pix;
+  int64_t pix_count;
+};
+
+/// Compute the work unit [low, high[ of P2(x, y):
+/// \sum pi(x / prime) - pi(low - 1) for all primes
+/// y < prime <= sqrt(x) with low <= x / prime < high.
+/// The primes inside [low, high[ are counted in bulk
+/// using a segmented sieve of Eratosthenes and
+/// the POPCNT instruction.
+///
+/// The work units of a thread are handed out in ascending
+/// order, hence their primes x / high < prime <= x / low
+/// are in descending order. The thread's primesieve
+/// iterator is reused across work units and only needs
+/// to be moved if another thread processed the work
+/// units in between.
+///
+template <typename T, typename Primes>
+MULTIARCH_TARGET_CLONES
+P2Work<T> P2_thread(T x,
+                    int64_t y,
+                    int64_t low,
+                    int64_t high,
+                    int64_t segment_size,
+                    Primes& primes,
+                    primesieve::iterator& rit,
+                    int64_t& prime)
+{
+  P2Work<T> work = { low, 0, 0, 0 };
+  int64_t sqrtx = isqrt(x);
+  int64_t start = (int64_t) max(x / high, y);
+  int64_t stop = (int64_t) min(x / low, sqrtx);
 
-  for (; prime <= stop; count++)
-    prime = it.next_prime();
+  if (prime <= 0 || prime > stop)
+  {
+    rit.skipto(stop + 1, start);
+    prime = rit.prev_prime();
+  }
 
-  return count;
-}
+  // all sieving primes are < low
+  int64_t sqrt_high = isqrt(high - 1);
+  int64_t max_i = upper_bound(primes.begin(), primes.end(), sqrt_high) - primes.begin() - 1;
+  int64_t c = min(max_i, 12);
+  Sieve sieve(low, segment_size, max_i + 1);
 
-/// Calculate the thread sieving distance. The idea is to
-/// gradually increase the thread_distance in order to
-/// keep all CPU cores busy.
-///
-void balanceLoad(int64_t* thread_distance, 
-                 int64_t low,
-                 int64_t z,
-                 int threads,
-                 double start_time)
-{
-  double seconds = get_time() - start_time;
+  for (; low < high; low += segment_size)
+  {
+    // current segment [low, segment_high[
+    int64_t segment_high = min(low + segment_size, high);
+    int64_t start_idx = 0;
 
-  int64_t min_distance = 1 << 23;
-  int64_t max_distance = ceil_div(z - low, threads);
+    sieve.pre_sieve(c, low, segment_high);
 
-  if (seconds < 60)
-    *thread_distance *= 2;
-  if (seconds > 60)
-    *thread_distance /= 2;
+    for (int64_t i = c + 1; i <= max_i; i++)
+      sieve.cross_off(i, primes[i]);
 
-  *thread_distance = in_between(min_distance, *thread_distance, max_distance);
-}
+    // \sum_{i = pi[start]+1}^{pi[stop]} pi(x / primes[i])
+    while (prime > start)
+    {
+      int64_t xp = (int64_t) fast_div(x, prime);
+      if (xp >= segment_high)
+        break;
+
+      int64_t stop_idx = xp - low;
+      work.pix += sieve.count(start_idx, stop_idx);
+      start_idx = stop_idx + 1;
+      work.p2 += work.pix;
+      work.pix_count++;
+      prime = rit.prev_prime();
+    }
 
-template <typename T>
-T P2_thread(T x,
-            int64_t y,
-            int64_t z,
-            int64_t low,
-            int64_t thread_num,
-            int64_t thread_distance,
-            int64_t& pix,
-            int64_t& pix_count)
-{
-  pix = 0;
-  pix_count = 0;
-  low += thread_distance * thread_num;
-  z = min(low + thread_distance, z);
-  int64_t start = (int64_t) max(x / z, y);
-  int64_t stop = (int64_t) min(x / low, isqrt(x));
-
-  primesieve::iterator rit(stop + 1, start);
-  primesieve::iterator it(low - 1, z);
-
-  int64_t next = it.next_prime();
-  int64_t prime = rit.prev_prime();
-  T p2 = 0;
-
-  // \sum_{i = pi[start]+1}^{pi[stop]} pi(x / primes[i])
-  while (prime > start &&
-         x / prime < z)
-  {
-    pix += count_primes(it, next, x / prime);
-    p2 += pix;
-    pix_count++;
-    prime = rit.prev_prime();
+    work.pix += sieve.count(start_idx, (segment_high - 1) - low);
   }
 
-  pix += count_primes(it, next, z - 1);
-
-  return p2;
+  return work;
 }
 
 /// P2(x, y) counts the numbers <= x that have exactly 2
@@ -123,43 +137,77 @@ T P2_OpenMP(T x, int64_t y, int threads)
 
   // \sum_{i=a+1}^{b} -(i - 1)
   T p2 = (a - 2) * (a + 1) / 2 - (b - 2) * (b + 1) / 2;
-  T pix_total = 0;
 
-  int64_t low = 2;
+  int64_t sqrtx = isqrt(x);
   int64_t z = (int64_t)(x / max(y, 1));
-  int64_t min_distance = 1 << 23;
-  int64_t thread_distance = min_distance;
+  int64_t sqrtz = isqrt(z);
+
+  // We sieve the interval [low, z[, all sieving
+  // primes <= sqrt(z) must be < low.
+  int64_t low = sqrtx - sqrtx % 30;
+  low = max(low, ceil_div(sqrtz + 1, 30) * 30);
+  T pix_low;
+
+  if (low <= sqrtx)
+    pix_low = b - (T) primesieve::count_primes(low, sqrtx);
+  else
+  {
+    // Only if y is tiny: x / prime < low
+    // for the largest primes <= sqrt(x).
+    PiTable pi(low - 1);
+    pix_low = pi[low - 1];
+    int64_t start = (int64_t) max(x / low, y);
+    primesieve::iterator it(start, sqrtx);
+    int64_t prime;
+
+    while ((prime = it.next_prime()) <= sqrtx)
+      p2 += pi[x / prime];
+  }
 
-  aligned_vector<int64_t> pix(threads);
-  aligned_vector<int64_t> pix_counts(threads);
+  if (low >= z)
+    return p2;
+
+  auto primes = generate_primes<int32_t>(sqrtz);
+  // P2 does not update a counter array, hence like
+  // primesieve we can use a sieve array that is
+  // larger than the L1 data cache.
+  int64_t sieve_size = primesieve::get_sieve_size() * (1 << 10);
+  int64_t segment_size = Sieve::get_segment_size(sieve_size * 30);
+  LoadBalancerP2 loadBalancer(x, low, z, threads);
+  threads = loadBalancer.get_threads();
+  vector<vector<P2Work<T>>> works(threads);
 
   // \sum_{i=a+1}^{b} pi(x / primes[i])
-  while (low < z)
+  #pragma omp parallel for num_threads(threads)
+  for (int i = 0; i < threads; i++)
   {
-    int64_t max_threads = ceil_div(z - low, thread_distance);
-    threads = in_between(1, threads, max_threads);
-    double time = get_time();
+    bind_thread();
+    int64_t thread_low = 0;
+    int64_t thread_high = 0;
+    int64_t prime = 0;
+    primesieve::iterator rit;
+
+    while (loadBalancer.get_work(&thread_low, &thread_high))
+      works[i].push_back(P2_thread(x, y, thread_low, thread_high, segment_size, primes, rit, prime));
+  }
 
-    #pragma omp parallel for num_threads(threads) reduction(+: p2)
-    for (int i = 0; i < threads; i++)
-      p2 += P2_thread(x, y, z, low, i, thread_distance, pix[i], pix_counts[i]);
+  vector<P2Work<T>> all;
+  for (auto& w : works)
+    all.insert(all.end(), w.begin(), w.end());
 
-    low += thread_distance * threads;
-    balanceLoad(&thread_distance, low, z, threads, time);
+  sort(all.begin(), all.end(),
+       [](const P2Work<T>& w1, const P2Work<T>& w2) {
+         return w1.low < w2.low;
+       });
 
-    // add missing sum contributions in order
-    for (int i = 0; i < threads; i++)
-    {
-      p2 += pix_total * pix_counts[i];
-      pix_total += pix[i];
-    }
+  // add the work units in order: the work unit
+  // [low, high[ requires pi(low - 1)
+  T pix_total = pix_low;
 
-    if (is_print())
-    {
-      double percent = get_percent(low, z);
-      cout << "\rStatus: " << fixed << setprecision(get_status_precision(x))
-           << percent << '%' << flush;
-    }
+  for (auto& w : all)
+  {
+    p2 += w.p2 + pix_total * w.pix_count;
+    pix_total += w.pix;
   }
 
   return p2;
@@ -3,26 +3,49 @@
 /// @brief 3rd partial sieve function, used in Lehmer's
 ///        prime counting formula.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
+#include <PiTable.hpp>
+#include <primesieve.hpp>
 #include <generate.hpp>
 #include <imath.hpp>
 #include <print.hpp>
 
 #include <stdint.h>
+#include <algorithm>
+#include <vector>
 
 using namespace std;
+using namespace primecount;
+
+namespace {
+
+/// Work item: primes[i] * primes[j] * primes[k]
+/// with j_low <= j <= j_high
+///
+struct P3Work
+{
+  int64_t i;
+  int64_t j_low;
+  int64_t j_high;
+};
+
+} // namespace
 
 namespace primecount {
 
 /// P3(x, a) counts the numbers <= x that have exactly 3
 /// prime factors each exceeding the a-th prime.
-/// Memory usage: O(pi(sqrt(x)))
+/// For the large j ranges of the first primes[i] the j
+/// range is split into chunks so that these do not
+/// dominate the computation.
+/// Memory usage: O(x / primes[a + 1]^2)
 ///
 int64_t P3(int64_t x, int64_t a, int threads)
 {
@@ -31,22 +54,48 @@ int64_t P3(int64_t x, int64_t a, int threads)
   print("Computation of the 3rd partial sieve function");
 
   double time = get_time();
-  auto primes = generate_primes<int32_t>(isqrt(x));
-
   int64_t y = iroot<3>(x);
-  int64_t pi_y = pi_bsearch(primes, y);
+  int64_t prime = primesieve::nth_prime(a + 1);
   int64_t sum = 0;
 
-  threads = ideal_num_threads(threads, pi_y, 100);
+  if (prime > y)
+  {
+    print("P3", sum, time);
+    return sum;
+  }
+
+  // largest x / (primes[i] * primes[j]) = x / primes[a + 1]^2
+  auto primes = generate_primes<int32_t>(isqrt(x / prime));
+  PiTable pi(x / (prime * prime));
+  int64_t pi_y = pi[y];
+  int64_t leaves = 0;
+
+  for (int64_t i = a + 1; i <= pi_y; i++)
+  {
+    int64_t bi = pi[isqrt(x / primes[i])];
+    leaves += bi - i + 1;
+  }
+
+  threads = ideal_num_threads(threads, leaves, 1000);
+  int64_t chunk_size = leaves / (threads * 64);
+  chunk_size = max(chunk_size, (int64_t) 1 << 10);
+  vector<P3Work> works;
 
-  #pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+: sum)
   for (int64_t i = a + 1; i <= pi_y; i++)
   {
-    int64_t xi = x / primes[i];
-    int64_t bi = pi_bsearch(primes, isqrt(xi));
+    int64_t bi = pi[isqrt(x / primes[i])];
+    for (int64_t j = i; j <= bi; j += chunk_size)
+      works.push_back({ i, j, min(j + chunk_size - 1, bi) });
+  }
+
+  #pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+: sum)
+  for (int64_t w = 0; w < (int64_t) works.size(); w++)
+  {
+    bind_thread();
+    int64_t xi = x / primes[works[w].i];
 
-    for (int64_t j = i; j <= bi; j++)
-      sum += pi_bsearch(primes, xi / primes[j]) - (j - 1);
+    for (int64_t j = works[w].j_low; j <= works[w].j_high; j++)
+      sum += pi[xi / primes[j]] - (j - 1);
   }
 
   print("P3", sum, time);
@@ -0,0 +1,75 @@
+///
+/// @file  PhiTable.cpp
+/// @brief The PhiTable class is a read-only lookup table of
+///        phi(x, a) results for small x (x <= 65535) and
+///        PhiTiny::max_a() < a < 100.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <PhiTable.hpp>
+#include <PhiTiny.hpp>
+#include <generate.hpp>
+
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+namespace primecount {
+
+// index_[r] = number of residues <= r that are
+// coprime to 30 i.e. { 1, 7, 11, 13, 17, 19, 23, 29 }
+const std::array<int, 30> PhiTable::index_ =
+{
+  0, 1, 1, 1, 1, 1, 1, 2, 2, 2,
+  2, 3, 3, 4, 4, 4, 4, 5, 5, 6,
+  6, 6, 6, 7, 7, 7, 7, 7, 7, 8
+};
+
+/// phi_[a][i] = phi(n - 1, a) where n is the i-th number
+/// coprime to 30. Hence phi(x, a) = phi_[a][i] where
+/// n is the smallest number > x coprime to 30.
+///
+PhiTable::PhiTable()
+{
+  auto primes = generate_n_primes<int32_t>(max_a() + 1);
+  int64_t limit = (max_x() / 30 + 1) * 30 + 30;
+  std::vector<char> sieve(limit, 1);
+  sieve[0] = 0;
+
+  for (int64_t a = 1; a <= max_a(); a++)
+  {
+    int64_t prime = primes[a];
+    for (int64_t n = prime; n < limit; n += prime)
+      sieve[n] = 0;
+
+    if (a <= PhiTiny::max_a())
+      continue;
+
+    phi_[a].resize(limit / 30 * 8);
+    int64_t i = 0;
+    uint16_t count = 0;
+
+    // For a > 3 only the numbers coprime
+    // to 30 can be unsieved.
+    for (int64_t n = 0; n < limit; n += 30)
+    {
+      for (int r : { 1, 7, 11, 13, 17, 19, 23, 29 })
+      {
+        phi_[a][i++] = count;
+        count += sieve[n + r];
+      }
+    }
+  }
+}
+
+const PhiTable& get_phi_table()
+{
+  static const PhiTable phiTable;
+  return phiTable;
+}
+
+} // namespace
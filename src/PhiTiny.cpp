@@ -3,36 +3,42 @@
 /// @brief phi(x, a) counts the numbers <= x that are not
 ///        divisible by any of the first a primes.
 ///        PhiTiny computes phi(x, a) in constant time
-///        for a <= 6 using lookup tables.
+///        for a <= 8 using lookup tables.
 ///
 ///        phi(x, a) = (x / pp) * φ(a) + phi(x % pp, a)
 ///        pp = 2 * 3 * ... * prime[a]
 ///        φ(a) = \prod_{i=1}^{a} (prime[i] - 1)
 ///
-/// Copyright (C) 2017 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <PhiTiny.hpp>
+#include <multiarch.hpp>
+
+#if defined(HAVE_LIBDIVIDE)
+  #include <libdivide.h>
+#endif
 
 #include <stdint.h>
 #include <array>
+#include <cstddef>
 #include <vector>
 
 namespace primecount {
 
-const std::array<int, 7> PhiTiny::primes = { 0, 2, 3, 5, 7, 11, 13 };
+const std::array<int, 9> PhiTiny::primes = { 0, 2, 3, 5, 7, 11, 13, 17, 19 };
 
 // prime_products[n] = \prod_{i=1}^{n} primes[i]
-const std::array<int, 7> PhiTiny::prime_products = { 1, 2, 6, 30, 210, 2310, 30030 };
+const std::array<int, 9> PhiTiny::prime_products = { 1, 2, 6, 30, 210, 2310, 30030, 510510, 9699690 };
 
 // totients[n] = \prod_{i=1}^{n} (primes[i] - 1)
-const std::array<int, 7> PhiTiny::totients = { 1, 1, 2, 8, 48, 480, 5760 };
+const std::array<int, 9> PhiTiny::totients = { 1, 1, 2, 8, 48, 480, 5760, 92160, 1658880 };
 
 // Number of primes below x
-const std::array<int, 13> PhiTiny::pi = { 0, 0, 1, 2, 2, 3, 3, 4, 4, 4, 4, 5, 5 };
+const std::array<int, 19> PhiTiny::pi = { 0, 0, 1, 2, 2, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7 };
 
 // Singleton
 const PhiTiny phiTiny;
@@ -42,7 +48,7 @@ PhiTiny::PhiTiny()
   phi_[0].push_back(0);
 
   // initialize phi(x % pp, a) lookup tables
-  for (int a = 1; a <= max_a(); a++)
+  for (int a = 1; a <= max_a_small; a++)
   {
     int pp = prime_products[a];
     phi_[a].resize(pp);
@@ -53,6 +59,99 @@ PhiTiny::PhiTiny()
       phi_[a][x] = (int16_t) phi_xa;
     }
   }
+
+  for (int a = max_a_small + 1; a <= max_a(); a++)
+    init_phi_bits(a);
+}
+
+/// Initialize the compressed phi(x % pp, a) lookup table.
+/// Bit i corresponds to the odd number 2 * i + 1, the bit
+/// is set if 2 * i + 1 is not divisible by any of the
+/// first a primes.
+///
+void PhiTiny::init_phi_bits(int64_t a)
+{
+  uint64_t pp = prime_products[a];
+  uint64_t odds = pp / 2;
+  uint64_t size = odds / 64 + 1;
+  std::vector<uint64_t> bits(size, ~0ull);
+
+  // 2 * i + 1 = 1 is not divisible by any prime
+  for (int i = 2; i <= a; i++)
+  {
+    uint64_t prime = primes[i];
+
+    // unset the odd multiples of prime
+    for (uint64_t n = prime; n < pp; n += prime * 2)
+    {
+      uint64_t j = n / 2;
+      bits[j / 64] &= ~(1ull << (j % 64));
+    }
+  }
+
+  auto& phi_bits = phi_bits_[a - max_a_small - 1];
+  phi_bits.resize(size);
+  uint32_t count = 0;
+
+  for (uint64_t i = 0; i < size; i++)
+  {
+    phi_bits[i].bits = bits[i];
+    phi_bits[i].count = count;
+    count += (uint32_t) popcnt64(bits[i]);
+  }
+}
+
+/// Batch version: out[i] = phi(xs[i], a).
+/// If libdivide is available the division x / pp is
+/// computed using a precomputed reciprocal of pp, this loop
+/// can also be auto-vectorized (with gather instructions for
+/// the table lookups) when compiled for AVX2 or AVX512.
+///
+MULTIARCH_TARGET_CLONES
+void PhiTiny::phi(const uint64_t* xs,
+                  std::size_t n,
+                  int64_t a,
+                  uint64_t* out) const
+{
+  assert(a <= max_a());
+
+  // libdivide's branchfree divider requires pp > 1
+  if (a == 0)
+  {
+    for (std::size_t i = 0; i < n; i++)
+      out[i] = xs[i];
+    return;
+  }
+
+  uint64_t pp = prime_products[a];
+  uint64_t totient = totients[a];
+
+#if defined(HAVE_LIBDIVIDE)
+  libdivide::branchfree_divider<uint64_t> fastdiv(pp);
+#else
+  uint64_t fastdiv = pp;
+#endif
+
+  if (a <= max_a_small)
+  {
+    const int16_t* phi = phi_[a].data();
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+      uint64_t q = xs[i] / fastdiv;
+      uint64_t r = xs[i] - q * pp;
+      out[i] = q * totient + phi[r];
+    }
+  }
+  else
+  {
+    for (std::size_t i = 0; i < n; i++)
+    {
+      uint64_t q = xs[i] / fastdiv;
+      uint64_t r = xs[i] - q * pp;
+      out[i] = q * totient + phi_bits(r, a);
+    }
+  }
 }
 
 } // namespace
@@ -5,13 +5,14 @@
 ///        and returns the number of primes <= n in O(1)
 ///        operations.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <PiTable.hpp>
+#include <multiarch.hpp>
 #include <primesieve.hpp>
 
 #include <stdint.h>
@@ -25,12 +26,20 @@ PiTable::PiTable(uint64_t max) :
   pi_.resize(max / 64 + 1);
   primesieve::iterator it(0, max);
 
-  uint64_t pix = 0;
   uint64_t prime = 0;
 
   while ((prime = it.next_prime()) <= max)
     pi_[prime / 64].bits |= 1ull << (prime % 64);
 
+  init_count();
+}
+
+/// Count the primes below each 64-bit word
+MULTIARCH_TARGET_CLONES
+void PiTable::init_count()
+{
+  uint64_t pix = 0;
+
   for (auto& i : pi_)
   {
     i.prime_count = pix;
@@ -4,7 +4,7 @@
 ///        in the Lagarias-Miller-Odlyzko and Deleglise-
 ///        Rivat prime counting algorithms.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -12,13 +12,18 @@
 
 #include <S1.hpp>
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <PhiTiny.hpp>
 #include <generate.hpp>
 #include <imath.hpp>
 #include <int128_t.hpp>
 #include <print.hpp>
+#include <TableCache.hpp>
 
 #include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <vector>
 
 using namespace std;
@@ -26,35 +31,166 @@ using namespace primecount;
 
 namespace {
 
-/// Recursively iterate over the square free numbers coprime
-/// to the first b primes and calculate the sum of the
-/// ordinary leaves. This algorithm is described in section
-/// 2.2 of the paper: Douglas Staple, "The Combinatorial
-/// Algorithm For Computing pi(x)", arXiv:1503.01839, 6
-/// March 2015.
+/// Work item: the children n = square_free * primes[i]
+/// with b_first <= i <= b_last and their subtrees.
+/// The ordinary leaf n contributes mu * phi(x / n, c).
 ///
-template <int MU, typename T, typename P>
+template <typename T>
+struct S1Work
+{
+  T square_free;
+  int64_t b_first;
+  int64_t b_last;
+  int mu;
+};
+
+/// The ordinary leaves are not computed one at a time,
+/// instead x / n is buffered and phi_tiny(x / n, c) is
+/// computed for many leaves at once using the batch
+/// version of phi_tiny(). 128-bit x / n values (only
+/// near the root if x > 2^64) are computed directly.
+///
+template <typename T>
+class S1Leaves
+{
+public:
+  S1Leaves(int64_t c) : c_(c), sum_(0)
+  {
+    xs_[0].reserve(max_size);
+    xs_[1].reserve(max_size);
+    phi_.resize(max_size);
+  }
+
+  void add(T xn, int mu)
+  {
+    if (sizeof(T) > sizeof(uint64_t) &&
+        xn > (T) numeric_limits<uint64_t>::max())
+    {
+      sum_ += phi_tiny(xn, c_) * mu;
+      return;
+    }
+
+    auto& xs = xs_[mu > 0];
+    xs.push_back((uint64_t) xn);
+    if (xs.size() >= max_size)
+      flush(xs, mu);
+  }
+
+  T sum()
+  {
+    flush(xs_[0], -1);
+    flush(xs_[1], 1);
+    return sum_;
+  }
+
+private:
+  static const size_t max_size = 256;
+
+  void flush(vector<uint64_t>& xs, int mu)
+  {
+    phi_tiny(xs.data(), xs.size(), c_, phi_.data());
+    T sum = 0;
+    for (size_t i = 0; i < xs.size(); i++)
+      sum += phi_[i];
+    sum_ += sum * mu;
+    xs.clear();
+  }
+
+  int64_t c_;
+  T sum_;
+  array<vector<uint64_t>, 2> xs_;
+  vector<uint64_t> phi_;
+};
+
+/// Iterate over the square free numbers coprime to the
+/// first c primes using an explicit stack and calculate
+/// the sum of the ordinary leaves of the work item.
+/// This algorithm is described in section 2.2 of the
+/// paper: Douglas Staple, "The Combinatorial Algorithm
+/// For Computing pi(x)", arXiv:1503.01839, 6 March 2015.
+///
+template <typename T, typename P>
 T S1_thread(T x,
             int64_t y,
-            int64_t b,
             int64_t c,
-            T square_free,
-            vector<P>& primes)
+            const S1Work<T>& work,
+            const vector<P>& primes)
+{
+  S1Leaves<T> leaves(c);
+  vector<S1Work<T>> stack;
+  stack.push_back(work);
+  int64_t pi_y = primes.size();
+
+  while (!stack.empty())
+  {
+    S1Work<T> node = stack.back();
+    stack.pop_back();
+
+    for (int64_t b = node.b_first; b <= node.b_last; b++)
+    {
+      T next = node.square_free * primes[b];
+      if (next > y) break;
+      leaves.add(x / next, node.mu);
+
+      // next has children if next * primes[b + 1] <= y
+      if (b + 1 < pi_y &&
+          next * primes[b + 1] <= y)
+        stack.push_back({ next, b + 1, pi_y - 1, -node.mu });
+    }
+  }
+
+  return leaves.sum();
+}
+
+/// Split the children of square_free into work items.
+/// The subtree of the child n = square_free * prime has
+/// about y / n nodes. Children whose subtree is larger
+/// than limit are split recursively, the other children
+/// are grouped into work items of about limit nodes.
+///
+template <typename T, typename P>
+T S1_split(T x,
+           int64_t y,
+           int64_t c,
+           T square_free,
+           int64_t b,
+           int mu,
+           int64_t limit,
+           const vector<P>& primes,
+           vector<S1Work<T>>& works)
 {
   T s1 = 0;
+  int64_t max_prime = (int64_t) (y / square_free);
+  int64_t b_max = upper_bound(primes.begin() + b, primes.end(), max_prime) - primes.begin() - 1;
+  int64_t max_heavy = (int64_t) (y / (square_free * limit));
+  int64_t b_heavy = upper_bound(primes.begin() + b, primes.end(), max_heavy) - primes.begin() - 1;
+  b_heavy = min(b_heavy, b_max);
 
-  for (b += 1; b < (int64_t) primes.size(); b++)
+  for (; b <= b_heavy; b++)
   {
     T next = square_free * primes[b];
-    if (next > y) break;
-    s1 += MU * phi_tiny(x / next, c);
-    s1 += S1_thread<-MU>(x, y, b, c, next, primes);
+    s1 += mu * phi_tiny(x / next, c);
+    s1 += S1_split(x, y, c, next, b + 1, -mu, limit, primes, works);
+  }
+
+  while (b <= b_max)
+  {
+    int64_t nodes = max_prime / primes[b];
+    int64_t size = max(limit / max(nodes, (int64_t) 1), (int64_t) 1);
+    int64_t b_last = min(b + size - 1, b_max);
+    works.push_back({ square_free, b, b_last, mu });
+    b = b_last + 1;
   }
 
   return s1;
 }
 
 /// Parallel computation of the ordinary leaves.
+/// The recursion tree is split into many work items
+/// of similar size which are processed using dynamic
+/// scheduling. This avoids that the threads which
+/// process the first primes (with the largest subtrees)
+/// finish last.
 /// Run time: O(y * log(log(y)))
 /// Memory usage: O(y / log(y))
 ///
@@ -64,18 +200,26 @@ X S1_OpenMP(X x,
             int64_t c,
             int threads)
 {
-  auto primes = generate_primes<Y>(y);
-  int64_t pi_y = primes.size();
+  auto primes_table = get_table<vector<Y>>(y, y, [&]() { return generate_primes<Y>(y); });
+  auto& primes = *primes_table;
   X s1 = phi_tiny(x, c);
 
+  if (c + 1 >= (int64_t) primes.size())
+    return s1;
+
   int64_t thread_threshold = ipow(10, 6);
   threads = ideal_num_threads(threads, y, thread_threshold);
 
-  #pragma omp parallel for schedule(static, 1) num_threads(threads) reduction (+: s1)
-  for (int64_t b = c + 1; b < pi_y; b++)
+  int64_t limit = y / (threads * 64);
+  limit = max(limit, (int64_t) 1 << 10);
+  vector<S1Work<X>> works;
+  s1 += S1_split(x, (int64_t) y, c, (X) 1, c + 1, -1, limit, primes, works);
+
+  #pragma omp parallel for schedule(dynamic) num_threads(threads) reduction (+: s1)
+  for (int64_t i = 0; i < (int64_t) works.size(); i++)
   {
-    s1 -= phi_tiny(x / primes[b], c);
-    s1 += S1_thread<1>(x, y, b, c, (X) primes[b], primes);
+    bind_thread();
+    s1 += S1_thread(x, (int64_t) y, c, works[i], primes);
   }
 
   return s1;
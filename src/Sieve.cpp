@@ -13,15 +13,18 @@
 ///        elements that have been crossed off for the first
 ///        time in the sieve array.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <Sieve.hpp>
+#include <primecount.hpp>
 #include <SieveTables.hpp>
 #include <popcnt.hpp>
+#include <imath.hpp>
+#include <multiarch.hpp>
 
 #include <stdint.h>
 #include <algorithm>
@@ -65,8 +68,100 @@ const WheelInit wheel_init[30] =
   {4,  7}, {3,  7}, {2,  7}, {1,  7}, {0,  7}
 };
 
+struct WheelStep
+{
+  uint8_t unset_bit;
+  uint8_t factor;
+  uint8_t correct;
+  uint8_t next;
+};
+
+/// The same wheel as in Sieve::cross_off() but one step
+/// at a time: unset bit, then move to the next multiple
+/// using multiple += prime / 30 * factor + correct.
+///
+const WheelStep wheel_steps[64] =
+{
+  { 0, 6, 0,  1 }, { 1, 4, 0,  2 }, { 2, 2, 0,  3 }, { 3, 4, 0,  4 },
+  { 4, 2, 0,  5 }, { 5, 4, 0,  6 }, { 6, 6, 0,  7 }, { 7, 2, 1,  0 },
+  { 1, 6, 1,  9 }, { 5, 4, 1, 10 }, { 4, 2, 1, 11 }, { 0, 4, 0, 12 },
+  { 7, 2, 1, 13 }, { 3, 4, 1, 14 }, { 2, 6, 1, 15 }, { 6, 2, 1,  8 },
+  { 2, 6, 2, 17 }, { 4, 4, 2, 18 }, { 0, 2, 0, 19 }, { 6, 4, 2, 20 },
+  { 1, 2, 0, 21 }, { 7, 4, 2, 22 }, { 3, 6, 2, 23 }, { 5, 2, 1, 16 },
+  { 3, 6, 3, 25 }, { 0, 4, 1, 26 }, { 6, 2, 1, 27 }, { 5, 4, 2, 28 },
+  { 2, 2, 1, 29 }, { 1, 4, 1, 30 }, { 7, 6, 3, 31 }, { 4, 2, 1, 24 },
+  { 4, 6, 3, 33 }, { 7, 4, 3, 34 }, { 1, 2, 1, 35 }, { 2, 4, 2, 36 },
+  { 5, 2, 1, 37 }, { 6, 4, 3, 38 }, { 0, 6, 3, 39 }, { 3, 2, 1, 32 },
+  { 5, 6, 4, 41 }, { 3, 4, 2, 42 }, { 7, 2, 2, 43 }, { 1, 4, 2, 44 },
+  { 6, 2, 2, 45 }, { 0, 4, 2, 46 }, { 4, 6, 4, 47 }, { 2, 2, 1, 40 },
+  { 6, 6, 5, 49 }, { 2, 4, 3, 50 }, { 3, 2, 1, 51 }, { 7, 4, 4, 52 },
+  { 0, 2, 1, 53 }, { 4, 4, 3, 54 }, { 5, 6, 5, 55 }, { 1, 2, 1, 48 },
+  { 7, 6, 6, 57 }, { 6, 4, 4, 58 }, { 5, 2, 2, 59 }, { 4, 4, 4, 60 },
+  { 3, 2, 2, 61 }, { 2, 4, 4, 62 }, { 1, 6, 6, 63 }, { 0, 2, 1, 56 }
+};
+
 /// Small primes used for pre-sieving
-const array<int, 10> primes = { 0, 2, 3, 5, 7, 11, 13, 17, 19, 23 };
+const array<int, 13> primes = { 0, 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+/// The multiples of the primes >= 7 inside the sieve array
+/// repeat periodically, the period (in bytes) is the product
+/// of the primes. Hence we precompute the sieve array of a
+/// few groups of primes and then pre-sieve each segment by
+/// copying these patterns into the sieve array.
+///
+class PreSieve
+{
+public:
+  struct Group
+  {
+    uint64_t first;
+    uint64_t last;
+    vector<byte_t> pattern;
+  };
+
+  PreSieve()
+  {
+    // Groups of consecutive primes (indexes into primes[]),
+    // 7 * 11 * 13 = 1001 bytes, 17 * 19 = 323 bytes,
+    // 23 * 29 = 667 bytes, 31 * 37 = 1147 bytes.
+    init_group(4, 6);
+    init_group(7, 8);
+    init_group(9, 10);
+    init_group(11, 12);
+  }
+
+  const vector<Group>& groups() const
+  {
+    return groups_;
+  }
+
+private:
+  void init_group(uint64_t first, uint64_t last)
+  {
+    const array<int, 8> bit_values = { 1, 7, 11, 13, 17, 19, 23, 29 };
+    uint64_t period = 1;
+
+    for (uint64_t i = first; i <= last; i++)
+      period *= primes[i];
+
+    Group group;
+    group.first = first;
+    group.last = last;
+    group.pattern.resize(period, 0xff);
+
+    for (uint64_t i = 0; i < period; i++)
+      for (uint64_t bit = 0; bit < 8; bit++)
+        for (uint64_t j = first; j <= last; j++)
+          if ((i * 30 + bit_values[bit]) % primes[j] == 0)
+            group.pattern[i] &= (byte_t) ~(1 << bit);
+
+    groups_.push_back(group);
+  }
+
+  vector<Group> groups_;
+};
+
+const PreSieve preSieve;
 
 /// Unset the n-th bit.
 /// @return  1 if n-th bit was previously set, else 0
@@ -94,6 +189,13 @@ Sieve::Sieve(uint64_t start,
   set_sieve_size(segment_size);
   wheel_.reserve(wheel_size);
   wheel_.resize(4);
+
+  // Primes > segment_size have
+  // at most 1 multiple per segment
+  bucket_limit_ = sieve_.size() * 30 + 1;
+  bucket_sieve_size_ = sieve_.size();
+  segment_ = 0;
+  bucket_pos_ = 0;
 }
 
 /// The segment size (a.k.a. sieve distance) is sieve
@@ -129,6 +231,7 @@ void Sieve::set_sieve_size(uint64_t segment_size)
 }
 
 /// Count 1 bits inside [start, stop]
+MULTIARCH_TARGET_CLONES
 uint64_t Sieve::count(uint64_t start, uint64_t stop) const
 {
   if (start > stop)
@@ -158,24 +261,89 @@ uint64_t Sieve::count(uint64_t start, uint64_t stop) const
 /// Pre-sieve the multiples of the first
 /// c primes inside [low, high[.
 ///
+MULTIARCH_TARGET_CLONES
 void Sieve::pre_sieve(uint64_t c, uint64_t low, uint64_t high)
 {
-  fill(sieve_.begin(), sieve_.end(), 0xff);
+  assert(c < primes.size());
+  assert(low % 30 == 0);
 
   uint64_t size = high - low;
+  uint64_t segment = (low - start_) / (bucket_sieve_size_ * 30);
+
+  if (segment != segment_)
+    load_bucket(segment);
 
   if (size < segment_size())
-  {
     set_sieve_size(size);
+
+  // cross_off(i, prime) requires that the
+  // wheels of the previous primes exist
+  for (uint64_t i = wheel_.size(); i <= c; i++)
+    add_wheel(primes[i]);
+
+  bool is_copied = false;
+
+  for (auto& group : preSieve.groups())
+  {
+    if (group.last <= c)
+    {
+      // the sieve array starts at byte
+      // (low / 30) % period of the pattern
+      uint64_t period = group.pattern.size();
+      uint64_t offset = (low / 30) % period;
+      copy_pattern(group.pattern, offset, is_copied);
+      is_copied = true;
+    }
+  }
+
+  if (!is_copied)
+    fill(sieve_.begin(), sieve_.end(), 0xff);
+
+  if (size < segment_size())
+  {
     auto sieve = (uint64_t*) &sieve_[0];
     uint64_t back = size - 1;
     sieve[back / 240] &= unset_larger[back % 240];
   }
 
-  assert(c < primes.size());
+  // Cross off the primes of the
+  // incomplete group using the wheel
+  for (auto& group : preSieve.groups())
+    if (group.last > c)
+      for (uint64_t i = group.first; i <= c; i++)
+        cross_off(i, primes[i]);
+}
+
+/// Copy (is_and = false) or bitwise AND (is_and = true)
+/// the pre-sieve pattern into the sieve array. The
+/// first sieve byte corresponds to pattern[offset].
+///
+MULTIARCH_TARGET_CLONES
+void Sieve::copy_pattern(const vector<byte_t>& pattern,
+                         uint64_t offset,
+                         bool is_and)
+{
+  byte_t* sieve = &sieve_[0];
+  uint64_t size = sieve_.size();
+  uint64_t period = pattern.size();
+  uint64_t i = 0;
+
+  while (i < size)
+  {
+    uint64_t bytes = min(period - offset, size - i);
+    const byte_t* p = &pattern[offset];
+
+    if (is_and)
+    {
+      for (uint64_t j = 0; j < bytes; j++)
+        sieve[i + j] &= p[j];
+    }
+    else
+      copy(p, p + bytes, sieve + i);
 
-  for (uint64_t i = 4; i <= c; i++)
-    cross_off(i, primes[i]);
+    i += bytes;
+    offset = 0;
+  }
 }
 
 /// Calculate the first multiple > start_ of prime
@@ -200,7 +368,120 @@ void Sieve::add_wheel(uint64_t prime)
   uint32_t index = wheel_init[quotient % 30].index;
   index += wheel_offsets[prime % 30];
 
-  wheel_.emplace_back((uint32_t) multiple, index);
+  if (prime < bucket_limit_)
+    wheel_.emplace_back((uint32_t) multiple, index);
+  else
+  {
+    // Large sieving primes are stored in the
+    // bucket of the segment of their next multiple
+    uint32_t i = (uint32_t) wheel_.size();
+    wheel_.emplace_back();
+    resize_buckets(prime);
+    push_bucket(BucketPrime(multiple, index, i));
+  }
+}
+
+/// The next multiple of a sieving prime is at most
+/// prime / 30 * 7 + 7 bytes ahead, hence the ring buffer
+/// of buckets must contain at least that many segments.
+///
+void Sieve::resize_buckets(uint64_t prime)
+{
+  uint64_t segments = (prime / 30 * 7 + 7) / bucket_sieve_size_ + 2;
+
+  if (segments <= buckets_.size())
+    return;
+
+  segments = next_power_of_2(segments);
+  vector<vector<BucketPrime>> buckets(segments);
+
+  for (auto& bucket : buckets_)
+    for (auto& bucketPrime : bucket)
+    {
+      uint64_t segment = bucketPrime.multiple / bucket_sieve_size_;
+      buckets[segment & (segments - 1)].push_back(bucketPrime);
+    }
+
+  buckets_.swap(buckets);
+}
+
+/// Add the sieving prime to the bucket
+/// of the segment of its next multiple.
+///
+void Sieve::push_bucket(const BucketPrime& bucketPrime)
+{
+  uint64_t segment = bucketPrime.multiple / bucket_sieve_size_;
+  assert(segment >= segment_);
+  assert(segment - segment_ < buckets_.size());
+
+  // cross_off() is called in ascending order
+  // of the prime index, new sieving primes have
+  // the largest prime index.
+  if (segment == segment_)
+    bucket_.push_back(bucketPrime);
+  else
+    buckets_[segment & (buckets_.size() - 1)].push_back(bucketPrime);
+}
+
+/// Move to the next segment: the bucket of the next
+/// segment becomes the current bucket. Sieving primes
+/// of the previous segment that have not been crossed off
+/// (because cross_off() was not called for them) are
+/// not needed anymore and are discarded.
+///
+void Sieve::load_bucket(uint64_t segment)
+{
+  // The buckets only hold the sieving primes of the
+  // next buckets_.size() segments. If a segment was
+  // skipped the results would silently be wrong.
+  if (segment != segment_ + 1)
+    throw primecount_error("Sieve: segments must be sieved in ascending order without gaps");
+
+  bucket_.clear();
+  bucket_pos_ = 0;
+  segment_ = segment;
+
+  if (!buckets_.empty())
+  {
+    bucket_.swap(buckets_[segment & (buckets_.size() - 1)]);
+    sort(bucket_.begin(), bucket_.end(),
+         [](const BucketPrime& a, const BucketPrime& b) {
+           return a.prime_index < b.prime_index;
+         });
+  }
+}
+
+/// Cross off the multiple of a large sieving prime
+/// inside the current segment (if any).
+///
+MULTIARCH_TARGET_CLONES
+uint64_t Sieve::cross_off_bucket(uint64_t i, uint64_t prime)
+{
+  uint64_t cnt = 0;
+  uint64_t segment_low = segment_ * bucket_sieve_size_;
+  uint64_t sieve_size = sieve_.size();
+
+  for (; bucket_pos_ < bucket_.size() &&
+         bucket_[bucket_pos_].prime_index == i; bucket_pos_++)
+  {
+    BucketPrime bucketPrime = bucket_[bucket_pos_];
+    uint64_t pos = bucketPrime.multiple - segment_low;
+
+    // beyond the end of the last segment
+    if (pos >= sieve_size)
+      continue;
+
+    const WheelStep& step = wheel_steps[bucketPrime.index];
+    byte_t& byte = sieve_[pos];
+    cnt += (byte >> step.unset_bit) & 1;
+    byte &= ~(1 << step.unset_bit);
+
+    bucketPrime.multiple += prime / 30 * step.factor + step.correct;
+    bucketPrime.index = step.next;
+    push_bucket(bucketPrime);
+  }
+
+  return cnt;
 }
 
 /// Remove the i-th prime and the multiples of the i-th
@@ -209,11 +490,15 @@ void Sieve::add_wheel(uint64_t prime)
 /// sieved elements whose least prime factor is the
 /// i-th prime. 
 ///
+MULTIARCH_TARGET_CLONES
 uint64_t Sieve::cross_off(uint64_t i, uint64_t prime)
 {
   if (i >= wheel_.size())
     add_wheel(prime);
 
+  if (prime >= bucket_limit_)
+    return cross_off_bucket(i, prime);
+
   uint64_t cnt = 0;
   uint32_t sieve_size = (uint32_t) sieve_.size();
   Wheel& wheel = wheel_[i];
@@ -0,0 +1,113 @@
+///
+/// @file  TableCache.cpp
+/// @brief LRU cache of the lookup tables (primes, PiTable,
+///        FactorTable) of the most recently used values of y.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <TableCache.hpp>
+
+#include <stdint.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <typeindex>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+using Tables = map<pair<type_index, int64_t>, shared_ptr<const void>>;
+
+/// The tables of each y, the most
+/// recently used y is at the front
+///
+list<pair<int64_t, Tables>> cache_;
+
+int cache_size_ = 0;
+
+/// Move the tables of y to the front
+Tables* find_y(int64_t y)
+{
+  auto iter = find_if(cache_.begin(), cache_.end(),
+      [&](const pair<int64_t, Tables>& entry) { return entry.first == y; });
+
+  if (iter == cache_.end())
+    return nullptr;
+
+  cache_.splice(cache_.begin(), cache_, iter);
+  return &cache_.front().second;
+}
+
+void evict()
+{
+  while ((int) cache_.size() > cache_size_)
+    cache_.pop_back();
+}
+
+} // namespace
+
+namespace primecount {
+
+void set_table_cache_size(int size)
+{
+  #pragma omp critical (table_cache)
+  {
+    cache_size_ = max(size, 0);
+    evict();
+  }
+}
+
+int get_table_cache_size()
+{
+  return cache_size_;
+}
+
+shared_ptr<const void> find_table(int64_t y,
+                                  type_index type,
+                                  int64_t limit)
+{
+  shared_ptr<const void> table;
+
+  #pragma omp critical (table_cache)
+  {
+    Tables* tables = find_y(y);
+
+    if (tables)
+    {
+      auto iter = tables->find(make_pair(type, limit));
+      if (iter != tables->end())
+        table = iter->second;
+    }
+  }
+
+  return table;
+}
+
+void insert_table(int64_t y,
+                  type_index type,
+                  int64_t limit,
+                  shared_ptr<const void> table)
+{
+  #pragma omp critical (table_cache)
+  {
+    Tables* tables = find_y(y);
+
+    if (!tables)
+    {
+      cache_.emplace_front(y, Tables());
+      tables = &cache_.front().second;
+    }
+
+    (*tables)[make_pair(type, limit)] = table;
+    evict();
+  }
+}
+
+} // namespace
@@ -3,7 +3,7 @@
 /// @brief  Parse command-line options for the primecount console
 ///         (terminal) application.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -13,6 +13,7 @@
 
 #include <primecount.hpp>
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <print.hpp>
 #include <int128_t.hpp>
 
@@ -35,6 +36,10 @@ map<string, OptionID> optionMap =
 {
   { "-a", OPTION_ALPHA },
   { "--alpha", OPTION_ALPHA },
+  { "--affinity", OPTION_AFFINITY },
+  { "--batch", OPTION_BATCH },
+  { "--cache_level", OPTION_CACHE_LEVEL },
+  { "--cache_size", OPTION_CACHE_SIZE },
   { "-d", OPTION_DELEGLISE_RIVAT },
   { "--deleglise_rivat", OPTION_DELEGLISE_RIVAT },
   { "--deleglise_rivat1", OPTION_DELEGLISE_RIVAT1 },
@@ -62,6 +67,7 @@ map<string, OptionID> optionMap =
   { "--number", OPTION_NUMBER },
   { "--P2", OPTION_P2 },
   { "--phi", OPTION_PHI },
+  { "--phi_cache", OPTION_PHI_CACHE },
   { "--pi", OPTION_PI },
   { "-p", OPTION_PRIMESIEVE },
   { "--primesieve", OPTION_PRIMESIEVE },
@@ -71,6 +77,7 @@ map<string, OptionID> optionMap =
   { "--S2_easy", OPTION_S2_EASY },
   { "--S2_hard", OPTION_S2_HARD },
   { "--S2_trivial", OPTION_S2_TRIVIAL },
+  { "--serve", OPTION_SERVE },
   { "-s", OPTION_STATUS },
   { "--status", OPTION_STATUS },
   { "--test", OPTION_TEST },
@@ -108,10 +115,32 @@ void optionStatus(Option& opt,
     set_status_precision(opt.to<int>());
 }
 
+void optionBatch(Option& opt,
+                 CmdOptions& opts)
+{
+  if (opt.val.empty())
+    throw primecount_error("missing value for option " + opt.str);
+
+  opts.batch = opt.val;
+}
+
+void optionAffinity(Option& opt)
+{
+  if (opt.val.empty())
+    throw primecount_error("missing value for option " + opt.str);
+
+  set_affinity(opt.val);
+}
+
 /// e.g. "--thread=4" -> return "--thread"
 string getOption(string str)
 {
-  size_t pos = str.find_first_of("=0123456789");
+  size_t pos = str.find('=');
+
+  if (pos != string::npos)
+    return str.substr(0, pos);
+
+  pos = str.find_first_of("0123456789");
 
   if (pos == string::npos)
     return str;
@@ -120,9 +149,16 @@ string getOption(string str)
 }
 
 /// e.g. "--thread=4" -> return "4"
+/// e.g. "--affinity=compact" -> return "compact"
+///
 string getValue(string str)
 {
-  size_t pos = str.find_first_of("0123456789");
+  size_t pos = str.find('=');
+
+  if (pos != string::npos)
+    return str.substr(pos + 1);
+
+  pos = str.find_first_of("0123456789");
 
   if (pos == string::npos)
     return string();
@@ -168,6 +204,12 @@ CmdOptions parseOptions(int argc, char* argv[])
     switch (optionMap[opt.opt])
     {
       case OPTION_ALPHA:   set_alpha(stod(opt.val)); break;
+      case OPTION_AFFINITY: optionAffinity(opt); break;
+      case OPTION_BATCH:   optionBatch(opt, opts); break;
+      case OPTION_SERVE:   opts.option = OPTION_SERVE; opts.socket = opt.val; break;
+      case OPTION_CACHE_LEVEL: set_cache_level(opt.to<int>()); break;
+      case OPTION_CACHE_SIZE: set_cache_size(opt.to<int64_t>() << 10); break;
+      case OPTION_PHI_CACHE: set_phi_cache_size(opt.to<int64_t>() << 20); break;
       case OPTION_NUMBER:  numbers.push_back(opt.to<maxint_t>()); break;
       case OPTION_THREADS: set_num_threads(opt.to<int>()); break;
       case OPTION_PHI:     opts.a = opt.to<int64_t>(); opts.option = OPTION_PHI; break;
@@ -180,12 +222,42 @@ CmdOptions parseOptions(int argc, char* argv[])
     }
   }
 
-  if (numbers.empty())
-    throw primecount_error("missing x number");
-  else
+  if (!numbers.empty())
     opts.x = numbers[0];
+  else if (opts.batch.empty() &&
+           opts.option != OPTION_SERVE)
+    throw primecount_error("missing x number");
 
   return opts;
 }
 
+/// Parse the options of a single command of a batch file
+/// e.g. "1e13 --nthprime --threads=8". The options that
+/// exit or start another mode are not allowed.
+///
+CmdOptions parseBatchOptions(vector<string>& args)
+{
+  vector<char*> argv;
+  argv.push_back((char*) "primecount");
+
+  for (string& arg : args)
+  {
+    Option opt = makeOption(arg);
+
+    switch (optionMap[opt.opt])
+    {
+      case OPTION_BATCH:
+      case OPTION_HELP:
+      case OPTION_SERVE:
+      case OPTION_TEST:
+      case OPTION_VERSION:
+        throw primecount_error(arg + " is not allowed in a batch file");
+      default:
+        argv.push_back(&arg[0]);
+    }
+  }
+
+  return parseOptions((int) argv.size(), argv.data());
+}
+
 } // namespace
@@ -1,7 +1,7 @@
 ///
 /// @file  cmdoptions.hpp
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -12,12 +12,18 @@
 
 #include <int128_t.hpp>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 namespace primecount {
 
 enum OptionID
 {
+  OPTION_AFFINITY,
   OPTION_ALPHA,
+  OPTION_BATCH,
+  OPTION_CACHE_LEVEL,
+  OPTION_CACHE_SIZE,
   OPTION_DELEGLISE_RIVAT,
   OPTION_DELEGLISE_RIVAT1,
   OPTION_DELEGLISE_RIVAT2,
@@ -40,6 +46,7 @@ enum OptionID
   OPTION_NUMBER,
   OPTION_P2,
   OPTION_PHI,
+  OPTION_PHI_CACHE,
   OPTION_PI,
   OPTION_PRIMESIEVE,
   OPTION_RI,
@@ -48,6 +55,7 @@ enum OptionID
   OPTION_S2_EASY,
   OPTION_S2_HARD,
   OPTION_S2_TRIVIAL,
+  OPTION_SERVE,
   OPTION_STATUS,
   OPTION_TEST,
   OPTION_TIME,
@@ -61,10 +69,14 @@ struct CmdOptions
   int64_t a = -1;
   int option = OPTION_PI;
   bool time = false;
+  std::string batch;
+  std::string socket;
 };
 
 CmdOptions parseOptions(int, char**);
 
+CmdOptions parseBatchOptions(std::vector<std::string>& args);
+
 } // namespace
 
 #endif
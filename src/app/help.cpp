@@ -8,6 +8,7 @@
 ///
 
 #include <primecount.hpp>
+#include <multiarch.hpp>
 
 #include <iostream>
 #include <cstdlib>
@@ -25,6 +26,11 @@ const string helpMenu
   "\n"
   "Options:\n"
   "\n"
+  "         --affinity=<mode>  Pin threads to CPU cores (Linux only), mode:\n"
+  "                            compact, scatter, none or a CPU list e.g. 0-3,8\n"
+  "         --batch=<file>     Compute the commands in file (one per line e.g.\n"
+  "                            1e13 --nthprime) and append the results to\n"
+  "                            <file>.results, finished commands are skipped\n"
   "  -d,    --deleglise_rivat  Count primes using Deleglise-Rivat algorithm\n"
   "         --legendre         Count primes using Legendre's formula\n"
   "         --lehmer           Count primes using Lehmer's formula\n"
@@ -36,8 +42,13 @@ const string helpMenu
   "  -p,    --primesieve       Count primes using the sieve of Eratosthenes\n"
   "         --phi=<a>          phi(x, a) counts the numbers <= x that are\n"
   "                            not divisible by any of the first a primes\n"
+  "         --phi_cache=<N>    Memory limit of the phi(x, a) cache in MiB,\n"
+  "                            default: 32 MiB\n"
   "         --Ri               Approximate pi(x) using Riemann R\n"
   "         --Ri_inverse       Approximate the nth prime using Ri^-1(x)\n"
+  "         --serve[=<path>]   Answer JSON requests (one per line) from stdin\n"
+  "                            or from a Unix domain socket at <path>,\n"
+  "                            e.g. {\"method\": \"pi\", \"x\": \"1e15\"}\n"
   "  -s[N], --status[=N]       Show computation progress 1%, 2%, 3%, ...\n"
   "                            [N] digits after decimal point e.g. N=1, 99.9%\n"
   "         --test             Run various correctness tests and exit\n"
@@ -49,6 +60,8 @@ const string helpMenu
   "Advanced Deleglise-Rivat options:\n"
   "\n"
   "  -a<N>, --alpha=<N>        Tuning factor, 1 <= alpha <= x^(1/6)\n"
+  "         --cache_level=<N>  Fit sieve array into L1 (N=1) or L2 (N=2) cache\n"
+  "         --cache_size=<N>   Sieve array size in KiB, default: L1 cache size\n"
   "         --P2               Only compute the 2nd partial sieve function\n"
   "         --S1               Only compute the ordinary leaves\n"
   "         --S2_trivial       Only compute the trivial special leaves\n"
@@ -81,6 +94,12 @@ void help()
 void version()
 {
   cout << versionInfo << endl;
+
+  // runtime ISA dispatch
+  string level = multiarch_level();
+  if (!level.empty())
+    cout << "Code path: " << level << endl;
+
   exit(0);
 }
 
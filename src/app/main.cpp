@@ -2,7 +2,7 @@
 /// @file   main.cpp
 /// @brief  primecount console application
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -21,9 +21,14 @@
 
 #include <stdint.h>
 #include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #ifdef HAVE_MPI
   #include <mpi.h>
@@ -158,6 +163,194 @@ maxint_t S2_hard(maxint_t x, int threads)
     return S2_hard(x, y, z, c, Ri(x), threads);
 }
 
+void serve(const string& socket_path);
+
+/// Run the computation selected on the command-line
+/// e.g. "1e13 --nthprime" -> nth_prime(1e13)
+///
+maxint_t compute(const CmdOptions& opt)
+{
+  auto x = opt.x;
+  auto a = opt.a;
+  auto threads = get_num_threads();
+
+  switch (opt.option)
+  {
+    case OPTION_DELEGLISE_RIVAT:
+      return pi_deleglise_rivat(x, threads);
+    case OPTION_DELEGLISE_RIVAT1:
+      return pi_deleglise_rivat1(to_int64(x));
+    case OPTION_DELEGLISE_RIVAT2:
+      return pi_deleglise_rivat2(to_int64(x));
+    case OPTION_DELEGLISE_RIVAT_PARALLEL1:
+      return pi_deleglise_rivat_parallel1(to_int64(x), threads);
+    case OPTION_LEGENDRE:
+      return pi_legendre(to_int64(x), threads);
+    case OPTION_LEHMER:
+      return pi_lehmer(to_int64(x), threads);
+    case OPTION_LMO:
+      return pi_lmo(to_int64(x), threads);
+    case OPTION_LMO1:
+      return pi_lmo1(to_int64(x));
+    case OPTION_LMO2:
+      return pi_lmo2(to_int64(x));
+    case OPTION_LMO3:
+      return pi_lmo3(to_int64(x));
+    case OPTION_LMO4:
+      return pi_lmo4(to_int64(x));
+    case OPTION_LMO5:
+      return pi_lmo5(to_int64(x));
+    case OPTION_LMO_PARALLEL:
+      return pi_lmo_parallel(to_int64(x), threads);
+    case OPTION_MEISSEL:
+      return pi_meissel(to_int64(x), threads);
+    case OPTION_PRIMESIEVE:
+      return pi_primesieve(to_int64(x));
+    case OPTION_P2:
+      return P2(x, threads);
+    case OPTION_PHI:
+      return phi(to_int64(x), a, threads);
+    case OPTION_PI:
+      return pi(x, threads);
+    case OPTION_LI:
+      return Li(x);
+    case OPTION_LIINV:
+      return Li_inverse(x);
+    case OPTION_RI:
+      return Ri(x);
+    case OPTION_RIINV:
+      return Ri_inverse(x);
+    case OPTION_NTHPRIME:
+      return nth_prime(to_int64(x), threads);
+    case OPTION_S1:
+      return S1(x, threads);
+    case OPTION_S2_EASY:
+      return S2_easy(x, threads);
+    case OPTION_S2_HARD:
+      return S2_hard(x, threads);
+    case OPTION_S2_TRIVIAL:
+      return S2_trivial(x, threads);
+#ifdef HAVE_INT128_T
+    case OPTION_DELEGLISE_RIVAT_PARALLEL2:
+      return pi_deleglise_rivat_parallel2(x, threads);
+#endif
+  }
+
+  return 0;
+}
+
+/// Key of a batch command e.g. " 1e13   --nthprime"
+/// -> "1e13 --nthprime"
+///
+string batch_key(const string& line, vector<string>& args)
+{
+  istringstream iss(line);
+  string arg;
+  string key;
+  args.clear();
+
+  while (iss >> arg)
+  {
+    if (!key.empty())
+      key += ' ';
+    key += arg;
+    args.push_back(arg);
+  }
+
+  return key;
+}
+
+/// Process the commands of the batch file (one command per
+/// line e.g. "1e13 --nthprime", empty lines and lines starting
+/// with '#' are skipped) within a single process. The results
+/// and timings are appended to <batch file>.results, commands
+/// that are already in that file are skipped. Hence an
+/// interrupted batch resumes where it stopped. A command that
+/// fails is written as an ERROR row (and retried at the next
+/// start), the following commands are still computed.
+///
+void batch(const CmdOptions& opts)
+{
+  string results_file = opts.batch + ".results";
+  set<string> done;
+  vector<string> args;
+  string line;
+
+  ifstream old_results(results_file);
+  while (getline(old_results, line))
+  {
+    size_t pos = line.find('\t');
+    if (pos != string::npos &&
+        line.compare(pos + 1, 5, "ERROR") != 0)
+      done.insert(line.substr(0, pos));
+  }
+
+  ifstream file(opts.batch);
+  if (!file)
+    throw primecount_error("failed to open " + opts.batch);
+
+  // With MPI only the master process writes the results
+  bool is_master = print_result();
+  ofstream results;
+
+  if (is_master)
+  {
+    results.open(results_file, ios::app);
+    if (!results)
+      throw primecount_error("failed to open " + results_file);
+  }
+
+  // The options of a batch command (e.g. --threads=8)
+  // must not affect the following commands.
+  Settings settings = get_settings();
+  int errors = 0;
+
+  while (getline(file, line))
+  {
+    string key = batch_key(line, args);
+
+    if (key.empty() ||
+        key[0] == '#' ||
+        done.count(key))
+      continue;
+
+    set_settings(settings);
+    double time = get_time();
+    string res;
+
+    try
+    {
+      CmdOptions opt = parseBatchOptions(args);
+      ostringstream oss;
+      oss << compute(opt);
+      res = oss.str();
+      done.insert(key);
+    }
+    catch (exception& e)
+    {
+      res = string("ERROR: ") + e.what();
+      errors++;
+    }
+
+    double seconds = get_time() - time;
+
+    if (is_master)
+    {
+      if (is_print())
+        cout << endl;
+
+      cout << key << " = " << res << endl;
+      results << key << '\t' << res << '\t'
+              << fixed << setprecision(3) << seconds << endl;
+    }
+  }
+
+  set_settings(settings);
+
+  if (errors > 0)
+    throw primecount_error(to_string(errors) + " batch command(s) failed, see " + results_file);
+}
+
 } // namespace
 
 int main (int argc, char* argv[])
@@ -171,82 +364,24 @@ int main (int argc, char* argv[])
     CmdOptions opt = parseOptions(argc, argv);
     double time = get_time();
 
-    auto x = opt.x;
-    auto a = opt.a;
-    auto threads = get_num_threads();
-    maxint_t res = 0;
-
-    switch (opt.option)
+    if (opt.option == OPTION_SERVE)
+      serve(opt.socket);
+    else if (!opt.batch.empty())
+      batch(opt);
+    else
     {
-      case OPTION_DELEGLISE_RIVAT:
-        res = pi_deleglise_rivat(x, threads); break;
-      case OPTION_DELEGLISE_RIVAT1:
-        res = pi_deleglise_rivat1(to_int64(x)); break;
-      case OPTION_DELEGLISE_RIVAT2:
-        res = pi_deleglise_rivat2(to_int64(x)); break;
-      case OPTION_DELEGLISE_RIVAT_PARALLEL1:
-        res = pi_deleglise_rivat_parallel1(to_int64(x), threads); break;
-      case OPTION_LEGENDRE:
-        res = pi_legendre(to_int64(x), threads); break;
-      case OPTION_LEHMER:
-        res = pi_lehmer(to_int64(x), threads); break;
-      case OPTION_LMO:
-        res = pi_lmo(to_int64(x), threads); break;
-      case OPTION_LMO1:
-        res = pi_lmo1(to_int64(x)); break;
-      case OPTION_LMO2:
-        res = pi_lmo2(to_int64(x)); break;
-      case OPTION_LMO3:
-        res = pi_lmo3(to_int64(x)); break;
-      case OPTION_LMO4:
-        res = pi_lmo4(to_int64(x)); break;
-      case OPTION_LMO5:
-        res = pi_lmo5(to_int64(x)); break;
-      case OPTION_LMO_PARALLEL:
-        res = pi_lmo_parallel(to_int64(x), threads); break;
-      case OPTION_MEISSEL:
-        res = pi_meissel(to_int64(x), threads); break;
-      case OPTION_PRIMESIEVE:
-        res = pi_primesieve(to_int64(x)); break;
-      case OPTION_P2:
-        res = P2(x, threads); break;
-      case OPTION_PHI:
-        res = phi(to_int64(x), a, threads); break;
-      case OPTION_PI:
-        res = pi(x, threads); break;
-      case OPTION_LI:
-        res = Li(x); break;
-      case OPTION_LIINV:
-        res = Li_inverse(x); break;
-      case OPTION_RI:
-        res = Ri(x); break;
-      case OPTION_RIINV:
-        res = Ri_inverse(x); break;
-      case OPTION_NTHPRIME:
-        res = nth_prime(to_int64(x), threads); break;
-      case OPTION_S1:
-        res = S1(x, threads); break;
-      case OPTION_S2_EASY:
-        res = S2_easy(x, threads); break;
-      case OPTION_S2_HARD:
-        res = S2_hard(x, threads); break;
-      case OPTION_S2_TRIVIAL:
-        res = S2_trivial(x, threads); break;
-#ifdef HAVE_INT128_T
-      case OPTION_DELEGLISE_RIVAT_PARALLEL2:
-        res = pi_deleglise_rivat_parallel2(x, threads); break;
-#endif
-    }
+      maxint_t res = compute(opt);
 
-    if (print_result())
-    {
-      if (is_print())
-        cout << endl;
+      if (print_result())
+      {
+        if (is_print())
+          cout << endl;
 
-      cout << res << endl;
+        cout << res << endl;
 
-      if (opt.time)
-        print_seconds(get_time() - time);
+        if (opt.time)
+          print_seconds(get_time() - time);
+      }
     }
   }
   catch (exception& e)
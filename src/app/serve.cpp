@@ -0,0 +1,474 @@
+///
+/// @file   serve.cpp
+/// @brief  primecount --serve reads one JSON request per line
+///         and writes one JSON response per line, e.g.
+///         {"id": 1, "method": "pi", "x": "1e15", "threads": 4}
+///         {"id": 1, "result": "29844570422669", "seconds": 0.412}
+///         Supported methods: pi, nth_prime, phi (with "a"),
+///         Li, Li_inverse, Ri and Ri_inverse. The requests are
+///         read from stdin or, with --serve=<path>, from the
+///         clients of a Unix domain socket. The process stays
+///         alive between requests, hence the thread pool and
+///         the PhiTable stay warm. The primes, PiTable and
+///         FactorTable of the most recently used values of y
+///         are kept in an LRU cache (TableCache.hpp), hence
+///         repeated queries skip the table construction.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <primecount.hpp>
+#include <primecount-internal.hpp>
+#include <TableCache.hpp>
+#include <int128_t.hpp>
+
+#include <stdint.h>
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/socket.h>
+  #include <sys/types.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+  #define HAVE_UNIX_SOCKET
+#endif
+
+using namespace std;
+using namespace primecount;
+
+namespace {
+
+struct JsonValue
+{
+  string str;
+  bool is_string;
+};
+
+/// Encode a Unicode code point as UTF-8
+string to_utf8(uint32_t code)
+{
+  string str;
+
+  if (code < 0x80)
+    str += (char) code;
+  else if (code < 0x800)
+  {
+    str += (char) (0xc0 | (code >> 6));
+    str += (char) (0x80 | (code & 0x3f));
+  }
+  else if (code < 0x10000)
+  {
+    str += (char) (0xe0 | (code >> 12));
+    str += (char) (0x80 | ((code >> 6) & 0x3f));
+    str += (char) (0x80 | (code & 0x3f));
+  }
+  else
+  {
+    str += (char) (0xf0 | (code >> 18));
+    str += (char) (0x80 | ((code >> 12) & 0x3f));
+    str += (char) (0x80 | ((code >> 6) & 0x3f));
+    str += (char) (0x80 | (code & 0x3f));
+  }
+
+  return str;
+}
+
+/// Parse a flat JSON object e.g. {"method": "pi", "x": 1e15}.
+/// String values are unescaped (including \uXXXX), other
+/// values (numbers) are returned as is.
+///
+map<string, JsonValue> parse_json(const string& line)
+{
+  map<string, JsonValue> obj;
+  size_t i = 0;
+
+  auto error = [&]() {
+    return primecount_error("invalid JSON request: " + line);
+  };
+
+  auto skip_space = [&]() {
+    while (i < line.size() && isspace((unsigned char) line[i]))
+      i++;
+  };
+
+  // 4 hex digits of a \uXXXX escape sequence
+  auto parse_hex4 = [&]() {
+    if (i + 4 > line.size())
+      throw error();
+    uint32_t code = 0;
+    for (size_t end = i + 4; i < end; i++)
+    {
+      char c = line[i];
+      if (!isxdigit((unsigned char) c))
+        throw error();
+      code = code * 16 + (isdigit((unsigned char) c)
+          ? c - '0'
+          : (tolower((unsigned char) c) - 'a' + 10));
+    }
+    return code;
+  };
+
+  // \uXXXX or a UTF-16 surrogate pair \uD83D\uDE00
+  auto parse_unicode = [&]() {
+    uint32_t code = parse_hex4();
+    if (code >= 0xdc00 && code <= 0xdfff)
+      throw error();
+    if (code >= 0xd800 && code <= 0xdbff)
+    {
+      if (line.compare(i, 2, "\\u") != 0)
+        throw error();
+      i += 2;
+      uint32_t low = parse_hex4();
+      if (low < 0xdc00 || low > 0xdfff)
+        throw error();
+      code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+    }
+    return code;
+  };
+
+  auto parse_string = [&]() {
+    string str;
+    if (line[i++] != '"')
+      throw error();
+    while (i < line.size() && line[i] != '"')
+    {
+      char c = line[i++];
+      if (c != '\\')
+      {
+        str += c;
+        continue;
+      }
+      if (i >= line.size())
+        throw error();
+      switch (line[i++])
+      {
+        case '"':  str += '"';  break;
+        case '\\': str += '\\'; break;
+        case '/':  str += '/';  break;
+        case 'b':  str += '\b'; break;
+        case 'f':  str += '\f'; break;
+        case 'n':  str += '\n'; break;
+        case 'r':  str += '\r'; break;
+        case 't':  str += '\t'; break;
+        case 'u':  str += to_utf8(parse_unicode()); break;
+        default:   throw error();
+      }
+    }
+    if (i++ >= line.size())
+      throw error();
+    return str;
+  };
+
+  skip_space();
+  if (i >= line.size() || line[i++] != '{')
+    throw error();
+
+  while (true)
+  {
+    skip_space();
+    if (i >= line.size())
+      throw error();
+    if (line[i] == '}')
+      break;
+
+    string key = parse_string();
+    skip_space();
+    if (i >= line.size() || line[i++] != ':')
+      throw error();
+    skip_space();
+    if (i >= line.size())
+      throw error();
+
+    if (line[i] == '"')
+      obj[key] = JsonValue{ parse_string(), true };
+    else
+    {
+      size_t pos = line.find_first_of(",}", i);
+      if (pos == string::npos)
+        throw error();
+      string val = line.substr(i, pos - i);
+      while (!val.empty() && isspace((unsigned char) val.back()))
+        val.pop_back();
+      obj[key] = JsonValue{ val, false };
+      i = pos;
+    }
+
+    skip_space();
+    if (i < line.size() && line[i] == ',')
+      i++;
+  }
+
+  return obj;
+}
+
+string json_escape(const string& str)
+{
+  string res;
+
+  for (char c : str)
+  {
+    switch (c)
+    {
+      case '"':  res += "\\\""; break;
+      case '\\': res += "\\\\"; break;
+      case '\b': res += "\\b"; break;
+      case '\f': res += "\\f"; break;
+      case '\n': res += "\\n"; break;
+      case '\r': res += "\\r"; break;
+      case '\t': res += "\\t"; break;
+      default:
+        // other control characters must be escaped as \u00XX
+        if ((unsigned char) c < 0x20)
+        {
+          const char* hex = "0123456789abcdef";
+          res += "\\u00";
+          res += hex[(c >> 4) & 0xf];
+          res += hex[c & 0xf];
+        }
+        else
+          res += c;
+    }
+  }
+
+  return res;
+}
+
+int64_t to_int64(maxint_t x)
+{
+  if (x > numeric_limits<int64_t>::max())
+    throw primecount_error("x must be < 2^63");
+  return (int64_t) x;
+}
+
+template <typename T>
+string to_str(T n)
+{
+  ostringstream oss;
+  oss << n;
+  return oss.str();
+}
+
+maxint_t compute(const string& method,
+                 maxint_t x,
+                 int64_t a,
+                 int threads)
+{
+  if (method == "pi")
+    return pi(x, threads);
+  if (method == "nth_prime")
+    return nth_prime(to_int64(x), threads);
+  if (method == "phi")
+    return phi(to_int64(x), a, threads);
+  if (method == "Li")
+    return Li(x);
+  if (method == "Li_inverse")
+    return Li_inverse(x);
+  if (method == "Ri")
+    return Ri(x);
+  if (method == "Ri_inverse")
+    return Ri_inverse(x);
+
+  throw primecount_error("unknown method " + method);
+}
+
+/// Answer a single JSON request.
+/// @return  JSON response (without newline)
+///
+string answer(const string& line, int default_threads)
+{
+  string id;
+  ostringstream response;
+  double time = get_time();
+
+  try
+  {
+    auto req = parse_json(line);
+
+    // echo the id in its original form
+    if (req.count("id"))
+    {
+      JsonValue& val = req["id"];
+      if (val.is_string)
+        id = "\"" + json_escape(val.str) + "\"";
+      else
+        id = val.str;
+    }
+
+    if (!req.count("method"))
+      throw primecount_error("missing method");
+    if (!req.count("x"))
+      throw primecount_error("missing x");
+
+    string method = req["method"].str;
+    maxint_t x = to_maxint(req["x"].str);
+    int64_t a = -1;
+    int threads = default_threads;
+
+    if (req.count("a"))
+      a = (int64_t) to_maxint(req["a"].str);
+    else if (method == "phi")
+      throw primecount_error("missing a");
+    if (req.count("threads"))
+      threads = (int) to_maxint(req["threads"].str);
+
+    set_num_threads(threads);
+    maxint_t res = compute(method, x, a, get_num_threads());
+    set_num_threads(default_threads);
+
+    response << "\"result\": \"" << res << "\", "
+             << "\"seconds\": " << get_time() - time;
+  }
+  catch (exception& e)
+  {
+    set_num_threads(default_threads);
+    response << "\"error\": \"" << json_escape(e.what()) << "\"";
+  }
+
+  string res = "{";
+  if (!id.empty())
+    res += "\"id\": " + id + ", ";
+  res += response.str() + "}";
+
+  return res;
+}
+
+bool is_blank(const string& line)
+{
+  return line.find_first_not_of(" \t\r") == string::npos;
+}
+
+#if defined(HAVE_UNIX_SOCKET)
+
+void write_all(int fd, const string& str)
+{
+  int flags = 0;
+
+#if defined(MSG_NOSIGNAL)
+  // Don't get killed by SIGPIPE if the client is gone
+  flags = MSG_NOSIGNAL;
+#endif
+
+  for (size_t i = 0; i < str.size();)
+  {
+    ssize_t n = send(fd, str.data() + i, str.size() - i, flags);
+    if (n <= 0)
+      return;
+    i += (size_t) n;
+  }
+}
+
+/// Accept the clients of the Unix domain socket one
+/// after the other and answer their requests.
+///
+void serve_socket(const string& path, int default_threads)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof(addr.sun_path))
+    throw primecount_error("socket path too long: " + path);
+
+  memcpy(addr.sun_path, path.c_str(), path.size());
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (server < 0)
+    throw primecount_error("failed to create socket " + path);
+
+  unlink(path.c_str());
+
+  if (bind(server, (sockaddr*) &addr, sizeof(addr)) < 0 ||
+      listen(server, 16) < 0)
+  {
+    close(server);
+    throw primecount_error("failed to listen on socket " + path);
+  }
+
+  while (true)
+  {
+    int client = accept(server, nullptr, nullptr);
+
+    if (client < 0)
+    {
+      // interrupted by a signal, try again
+      if (errno == EINTR)
+        continue;
+
+      // e.g. EMFILE, retrying would busy-spin
+      string error = strerror(errno);
+      close(server);
+      throw primecount_error("failed to accept a client on socket " + path + ": " + error);
+    }
+
+    string buffer;
+    char buf[1 << 12];
+    ssize_t n;
+
+    while ((n = read(client, buf, sizeof(buf))) > 0)
+    {
+      buffer.append(buf, (size_t) n);
+      size_t pos;
+
+      while ((pos = buffer.find('\n')) != string::npos)
+      {
+        string line = buffer.substr(0, pos);
+        buffer.erase(0, pos + 1);
+        if (!is_blank(line))
+          write_all(client, answer(line, default_threads) + "\n");
+      }
+    }
+
+    close(client);
+  }
+}
+
+#endif
+
+} // namespace
+
+namespace primecount {
+
+/// Answer the requests from stdin until EOF, or
+/// if a path is given from a Unix domain socket.
+///
+void serve(const string& socket_path)
+{
+#ifdef HAVE_MPI
+  if (mpi_num_procs() > 1)
+    throw primecount_error("--serve does not support MPI");
+#endif
+
+  int default_threads = get_num_threads();
+
+  // keep the tables of the last 4 values of y
+  set_table_cache_size(4);
+
+  if (!socket_path.empty())
+  {
+#if defined(HAVE_UNIX_SOCKET)
+    serve_socket(socket_path, default_threads);
+#else
+    throw primecount_error("--serve=<path>: Unix domain sockets are not supported");
+#endif
+  }
+
+  string line;
+
+  while (getline(cin, line))
+    if (!is_blank(line))
+      cout << answer(line, default_threads) << endl;
+}
+
+} // namespace
@@ -13,16 +13,20 @@
 ///        POPCNT instruction. Hence this implementation does not use
 ///        a binary indexed tree.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <PiTable.hpp>
+#include <PhiTable.hpp>
 #include <FactorTable.hpp>
+#include <Divider128.hpp>
 #include <Sieve.hpp>
+#include <TableCache.hpp>
 #include <fast_div.hpp>
 #include <generate.hpp>
 #include <generate_phi.hpp>
@@ -30,10 +34,12 @@
 #include <int128_t.hpp>
 #include <LoadBalancer.hpp>
 #include <min.hpp>
+#include <multiarch.hpp>
 #include <print.hpp>
 #include <S2.hpp>
 
 #include <stdint.h>
+#include <memory>
 #include <vector>
 
 using namespace std;
@@ -41,11 +47,26 @@ using namespace primecount;
 
 namespace {
 
+/// The sieve and the phi vector of a thread's last
+/// work unit. If the thread's next work unit starts
+/// where the last one ended (and uses the same
+/// segment size) we continue sieving instead of
+/// initializing a new sieve and phi vector.
+///
+struct ThreadSieve
+{
+  int64_t low = -1;
+  int64_t segment_size = 0;
+  std::unique_ptr<Sieve> sieve;
+  vector<int64_t> phi;
+};
+
 /// Compute the contribution of the hard special leaves
 /// using a sieve. Each thread processes the interval
 /// [low, low + segments * segment_size[
 ///
 template <typename T, typename FactorTable, typename Primes>
+MULTIARCH_TARGET_CLONES
 T S2_hard_thread(T x,
                  int64_t y,
                  int64_t z,
@@ -54,8 +75,10 @@ T S2_hard_thread(T x,
                  int64_t segments,
                  int64_t segment_size,
                  FactorTable& factor,
-                 PiTable& pi,
+                 const PiTable& pi,
                  Primes& primes,
+                 vector<Divider128>& dividers,
+                 ThreadSieve& thread,
                  Runtime& runtime)
 {
   int64_t low1 = max(low, 1);
@@ -67,10 +90,20 @@ T S2_hard_thread(T x,
   if (c > max_b)
     return s2_hard;
 
-  runtime.init_start();
-  Sieve sieve(low, segment_size, max_b);
-  auto phi = generate_phi(low, max_b, primes, pi);
-  runtime.init_stop();
+  // max_b decreases as low increases, hence the
+  // previous sieve has all wheels we need.
+  if (low != thread.low ||
+      segment_size != thread.segment_size)
+  {
+    runtime.init_start();
+    thread.sieve.reset(new Sieve(low, segment_size, max_b));
+    thread.phi = generate_phi(low, max_b, primes, pi);
+    thread.segment_size = segment_size;
+    runtime.init_stop();
+  }
+
+  Sieve& sieve = *thread.sieve;
+  auto& phi = thread.phi;
 
   // Segmented sieve of Eratosthenes
   for (; low < limit; low += segment_size)
@@ -142,7 +175,7 @@ T S2_hard_thread(T x,
 
       for (; primes[l] > min_hard; l--)
       {
-        int64_t xn = (int64_t) fast_div(x2, primes[l]);
+        int64_t xn = fast_div(x2, l, primes, dividers);
         int64_t stop = xn - low;
         count += sieve.count(start, stop, low, high, count, count_low_high);
         start = stop + 1;
@@ -157,6 +190,8 @@ T S2_hard_thread(T x,
     next_segment:;
   }
 
+  thread.low = low;
+
   return s2_hard;
 }
 
@@ -181,21 +216,32 @@ T S2_hard_OpenMP(T x,
 
   LoadBalancer loadBalancer(x, y, z, s2_hard_approx);
   int64_t max_prime = min(y, z / isqrt(y));
-  PiTable pi(max_prime);
+  auto pi_table = get_table<PiTable>(y, max_prime, [&]() { return PiTable(max_prime); });
+  const PiTable& pi = *pi_table;
+
+  // initialize the shared phi(x, a) table of
+  // generate_phi() before the threads start
+  get_phi_table();
+
+  // if x > 2^64 precompute the reciprocals of the
+  // primes used in the hard special leaf divisions
+  auto dividers = divider128_vector(x, primes);
 
   #pragma omp parallel for num_threads(threads)
   for (int i = 0; i < threads; i++)
   {
+    bind_thread();
     int64_t low = 0;
     int64_t segments = 0;
     int64_t segment_size = 0;
     T s2_hard = 0;
+    ThreadSieve thread;
     Runtime runtime;
 
     while (loadBalancer.get_work(&low, &segments, &segment_size, s2_hard, runtime))
     {
       runtime.start();
-      s2_hard = S2_hard_thread(x, y, z, c, low, segments, segment_size, factor, pi, primes, runtime);
+      s2_hard = S2_hard_thread(x, y, z, c, low, segments, segment_size, factor, pi, primes, dividers, thread, runtime);
       runtime.stop();
     }
   }
@@ -227,11 +273,11 @@ int64_t S2_hard(int64_t x,
   print(x, y, c, threads);
 
   double time = get_time();
-  FactorTable<uint16_t> factor(y, threads);
+  auto factor = get_table<FactorTable<uint16_t>>(y, y, [&]() { return FactorTable<uint16_t>(y, threads); });
   int64_t max_prime = min(y, z / isqrt(y));
-  auto primes = generate_primes<int32_t>(max_prime);
+  auto primes = get_table<vector<int32_t>>(y, max_prime, [&]() { return generate_primes<int32_t>(max_prime); });
 
-  int64_t s2_hard = S2_hard_OpenMP((intfast64_t) x, y, z, c, (intfast64_t) s2_hard_approx, primes, factor, threads);
+  int64_t s2_hard = S2_hard_OpenMP((intfast64_t) x, y, z, c, (intfast64_t) s2_hard_approx, *primes, *factor, threads);
 
   print("S2_hard", s2_hard, time);
   return s2_hard;
@@ -262,19 +308,19 @@ int128_t S2_hard(int128_t x,
   // uses less memory
   if (y <= FactorTable<uint16_t>::max())
   {
-    FactorTable<uint16_t> factor(y, threads);
+    auto factor = get_table<FactorTable<uint16_t>>(y, y, [&]() { return FactorTable<uint16_t>(y, threads); });
     int64_t max_prime = min(y, z / isqrt(y));
-    auto primes = generate_primes<uint32_t>(max_prime);
+    auto primes = get_table<vector<uint32_t>>(y, max_prime, [&]() { return generate_primes<uint32_t>(max_prime); });
 
-    s2_hard = S2_hard_OpenMP((intfast128_t) x, y, z, c, (intfast128_t) s2_hard_approx, primes, factor, threads);
+    s2_hard = S2_hard_OpenMP((intfast128_t) x, y, z, c, (intfast128_t) s2_hard_approx, *primes, *factor, threads);
   }
   else
   {
-    FactorTable<uint32_t> factor(y, threads);
+    auto factor = get_table<FactorTable<uint32_t>>(y, y, [&]() { return FactorTable<uint32_t>(y, threads); });
     int64_t max_prime = min(y, z / isqrt(y));
-    auto primes = generate_primes<int64_t>(max_prime);
+    auto primes = get_table<vector<int64_t>>(y, max_prime, [&]() { return generate_primes<int64_t>(max_prime); });
 
-    s2_hard = S2_hard_OpenMP((intfast128_t) x, y, z, c, (intfast128_t) s2_hard_approx, primes, factor, threads);
+    s2_hard = S2_hard_OpenMP((intfast128_t) x, y, z, c, (intfast128_t) s2_hard_approx, *primes, *factor, threads);
   }
 
   print("S2_hard", s2_hard, time);
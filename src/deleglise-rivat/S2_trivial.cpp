@@ -3,7 +3,7 @@
 /// @brief Calculate the contribution of the trivial special leaves
 ///        in parallel using OpenMP.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -12,7 +12,7 @@
 #include <PiTable.hpp>
 #include <primecount.hpp>
 #include <primecount-internal.hpp>
-#include <primesieve.hpp>
+#include <CpuAffinity.hpp>
 #include <int128_t.hpp>
 #include <imath.hpp>
 #include <print.hpp>
@@ -32,31 +32,59 @@ T S2_trivial_OpenMP(T x,
                     int64_t c,
                     int threads)
 {
-  int64_t thread_threshold = ipow(10, 7);
-  threads = ideal_num_threads(threads, y, thread_threshold);
-
   PiTable pi(y);
   int64_t pi_y = pi[y];
   int64_t sqrtz = isqrt(z);
   int64_t prime_c = nth_prime(c);
+  int64_t x13 = iroot<3>(x);
+  int64_t start = max(prime_c, sqrtz) + 1;
+  int64_t stop = min(x13 + 1, y);
 
   T s2_trivial = 0;
 
   // Find all trivial leaves: n = primes[b] * primes[l]
-  // which satisfy phi(x / n), b - 1) = 1
+  // which satisfy phi(x / n), b - 1) = 1.
+  // For primes > x^(1/3) we have x / prime^2 < prime,
+  // hence each prime contributes pi_y - pi[prime] and
+  // the sum over these primes is an arithmetic series:
+  // \sum_{i=i1}^{i2} (pi_y - i)
+  int64_t start2 = max(start, x13 + 1);
+
+  if (start2 < y)
+  {
+    T i1 = pi[start2 - 1] + 1;
+    T i2 = pi[y - 1];
+
+    if (i1 <= i2)
+    {
+      T n = i2 - i1 + 1;
+      s2_trivial += n * pi_y - (i1 + i2) * n / 2;
+    }
+  }
+
+  if (start >= stop)
+    return s2_trivial;
+
+  // For the primes <= x^(1/3) we need to
+  // lookup pi(x / prime^2) for each prime
+  int64_t thread_threshold = ipow(10, 7);
+  threads = ideal_num_threads(threads, stop - start, thread_threshold);
+
   #pragma omp parallel for num_threads(threads) reduction(+: s2_trivial)
   for (int64_t i = 0; i < threads; i++)
   {
-    int64_t start = max(prime_c, sqrtz) + 1;
-    int64_t thread_distance = ceil_div(y - start, threads);
-    start += thread_distance * i;
-    int64_t stop = min(start + thread_distance, y);
-    primesieve::iterator it(start - 1, stop);
-    T prime;
-
-    while ((prime = it.next_prime()) < stop)
+    bind_thread();
+    int64_t thread_distance = ceil_div(stop - start, threads);
+    int64_t low = start + thread_distance * i;
+    int64_t high = min(low + thread_distance, stop);
+
+    // The primes < y are read from the shared
+    // PiTable, no need to sieve them again.
+    for (T prime = pi.next_prime(low);
+         prime > 0 && prime < high;
+         prime = pi.next_prime((uint64_t) prime + 1))
     {
-      int64_t xn = (int64_t) max(x / (prime * prime), prime);
+      int64_t xn = (int64_t) (x / (prime * prime));
       s2_trivial += pi_y - pi[xn];
     }
   }
@@ -13,6 +13,7 @@
 ///
 
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <Sieve.hpp>
 #include <generate.hpp>
 #include <generate_phi.hpp>
@@ -170,6 +171,7 @@ int64_t S2(int64_t x,
   #pragma omp parallel for num_threads(threads)
   for (int i = 0; i < threads; i++)
   {
+    bind_thread();
     int64_t low = 0;
     int64_t segments = 0;
     int64_t segment_size = 0;
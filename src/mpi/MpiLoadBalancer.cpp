@@ -57,9 +57,8 @@ MpiLoadBalancer::MpiLoadBalancer(maxint_t x,
   smallest_hard_leaf_ = (int64_t) (x / (y * sqrt(alpha) * x16));
 
   // try to use a segment size that fits exactly
-  // into the CPUs L1 data cache
-  int64_t l1_dcache_size = 1 << 15;
-  int64_t size = l1_dcache_size * 30;
+  // into the CPUs L1 (or L2) cache
+  int64_t size = get_cache_size() * 30;
   size = max(size, isqrt(z));
   segment_size_ = Sieve::get_segment_size(size);
 }
@@ -11,6 +11,7 @@
 ///
 
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <primesieve.hpp>
 #include <aligned_vector.hpp>
 #include <int128_t.hpp>
@@ -74,6 +75,7 @@ T P2_thread(T x,
             int64_t& pix,
             int64_t& pix_count)
 {
+  bind_thread();
   pix = 0;
   pix_count = 0;
   low += thread_distance * thread_num;
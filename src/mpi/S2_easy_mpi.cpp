@@ -4,7 +4,7 @@
 ///        and the sparse easy leaves in parallel using OpenMP
 ///        (Deleglise-Rivat algorithm).
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -12,12 +12,14 @@
 
 #include <PiTable.hpp>
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <mpi_reduce_sum.hpp>
 #include <generate.hpp>
 #include <int128_t.hpp>
 #include <min.hpp>
 #include <imath.hpp>
 #include <S2Status.hpp>
+#include <S2_easy_chunks.hpp>
 #include <fast_div.hpp>
 #include <print.hpp>
 
@@ -29,6 +31,55 @@ using namespace primecount;
 
 namespace {
 
+/// Calculate the contribution of the clustered easy
+/// leaves and the sparse easy leaves of the b-th prime:
+/// n = primes[b] * primes[l] with l_low < l <= l_high.
+///
+template <typename T, typename Primes>
+T S2_easy_leaves(T x,
+                 int64_t y,
+                 int64_t b,
+                 int64_t l_high,
+                 int64_t l_low,
+                 Primes& primes,
+                 PiTable& pi)
+{
+  T s2_easy = 0;
+  int64_t prime = primes[b];
+  T x2 = x / prime;
+  int64_t min_clustered = (int64_t) isqrt(x2);
+  min_clustered = in_between(prime, min_clustered, y);
+
+  int64_t l = l_high;
+  int64_t pi_min_clustered = max(pi[min_clustered], l_low);
+  int64_t pi_min_sparse = l_low;
+
+  // Find all clustered easy leaves:
+  // n = primes[b] * primes[l]
+  // x / n <= y && phi(x / n, b - 1) == phi(x / m, b - 1)
+  // where phi(x / n, b - 1) = pi(x / n) - b + 2
+  while (l > pi_min_clustered)
+  {
+    int64_t xn = (int64_t) fast_div(x2, primes[l]);
+    int64_t phi_xn = pi[xn] - b + 2;
+    int64_t xm = (int64_t) fast_div(x2, primes[b + phi_xn - 1]);
+    int64_t l2 = max(pi[xm], l_low);
+    s2_easy += phi_xn * (l - l2);
+    l = l2;
+  }
+
+  // Find all sparse easy leaves:
+  // n = primes[b] * primes[l]
+  // x / n <= y && phi(x / n, b - 1) = pi(x / n) - b + 2
+  for (; l > pi_min_sparse; l--)
+  {
+    int64_t xn = (int64_t) fast_div(x2, primes[l]);
+    s2_easy += pi[xn] - b + 2;
+  }
+
+  return s2_easy;
+}
+
 /// Calculate the contribution of the clustered easy leaves
 /// and the sparse easy leaves.
 /// @param T  either int64_t or uint128_t.
@@ -54,47 +105,33 @@ T S2_easy_mpi_master(T x,
   int proc_id = mpi_proc_id();
   int procs = mpi_num_procs();
 
-  #pragma omp parallel for schedule(dynamic) num_threads(threads) reduction(+: s2_easy)
-  for (int64_t b = max(c, pi_sqrty) + 1 + proc_id; b <= pi_x13; b += procs)
+  vector<S2EasyChunk> chunks;
+  int64_t b_start = max(c, pi_sqrty) + 1 + proc_id;
+  b_start = S2_easy_chunks(x, y, z, b_start, pi_x13, procs, threads, primes, pi, chunks);
+
+  #pragma omp parallel num_threads(threads) reduction(+: s2_easy)
   {
-    int64_t prime = primes[b];
-    T x2 = x / prime;
-    int64_t min_trivial = min(x2 / prime, y);
-    int64_t min_clustered = (int64_t) isqrt(x2);
-    int64_t min_sparse = z / prime;
-
-    min_clustered = in_between(prime, min_clustered, y);
-    min_sparse = in_between(prime, min_sparse, y);
-
-    int64_t l = pi[min_trivial];
-    int64_t pi_min_clustered = pi[min_clustered];
-    int64_t pi_min_sparse = pi[min_sparse];
-
-    // Find all clustered easy leaves:
-    // n = primes[b] * primes[l]
-    // x / n <= y && phi(x / n, b - 1) == phi(x / m, b - 1)
-    // where phi(x / n, b - 1) = pi(x / n) - b + 2
-    while (l > pi_min_clustered)
+    bind_thread();
+
+    // The primes with the most easy leaves
+    // are split into chunks of similar size
+    #pragma omp for schedule(dynamic) nowait
+    for (int64_t i = 0; i < (int64_t) chunks.size(); i++)
     {
-      int64_t xn = (int64_t) fast_div(x2, primes[l]);
-      int64_t phi_xn = pi[xn] - b + 2;
-      int64_t xm = (int64_t) fast_div(x2, primes[b + phi_xn - 1]);
-      int64_t l2 = pi[xm];
-      s2_easy += phi_xn * (l - l2);
-      l = l2;
+      auto& chunk = chunks[i];
+      s2_easy += S2_easy_leaves(x, y, chunk.b, chunk.l_high, chunk.l_low, primes, pi);
     }
 
-    // Find all sparse easy leaves:
-    // n = primes[b] * primes[l]
-    // x / n <= y && phi(x / n, b - 1) = pi(x / n) - b + 2
-    for (; l > pi_min_sparse; l--)
+    #pragma omp for schedule(dynamic)
+    for (int64_t b = b_start; b <= pi_x13; b += procs)
     {
-      int64_t xn = (int64_t) fast_div(x2, primes[l]);
-      s2_easy += pi[xn] - b + 2;
-    }
+      int64_t l_high, l_low;
+      S2_easy_range(x, y, z, b, primes, pi, &l_high, &l_low);
+      s2_easy += S2_easy_leaves(x, y, b, l_high, l_low, primes, pi);
 
-    if (is_print())
-      status.print(b, pi_x13);
+      if (is_print())
+        status.print(b, pi_x13);
+    }
   }
 
   s2_easy = mpi_reduce_sum(s2_easy);
@@ -5,20 +5,23 @@
 ///        divides with comparatively cheap multiplication and
 ///        bitshifts.
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
 ///
 
 #include <PiTable.hpp>
+#include <Divider128.hpp>
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <generate.hpp>
 #include <int128_t.hpp>
 #include <min.hpp>
 #include <mpi_reduce_sum.hpp>
 #include <imath.hpp>
 #include <S2Status.hpp>
+#include <S2_easy_chunks.hpp>
 #include <print.hpp>
 
 #include <libdivide.h>
@@ -47,6 +50,103 @@ libdivide_vector(Primes& primes)
   return fastdiv;
 }
 
+/// Calculate the contribution of the clustered easy
+/// leaves and the sparse easy leaves of the b-th prime:
+/// n = primes[b] * primes[l] with l_low < l <= l_high.
+///
+template <typename T, typename Primes>
+T S2_easy_leaves(T x,
+                 int64_t y,
+                 int64_t b,
+                 int64_t l_high,
+                 int64_t l_low,
+                 Primes& primes,
+                 PiTable& pi,
+                 vector<fastdiv_t>& fastdiv,
+                 vector<Divider128>& dividers)
+{
+  T s2_easy = 0;
+  int64_t prime = primes[b];
+  T x2 = x / prime;
+  int64_t min_clustered = (int64_t) isqrt(x2);
+  min_clustered = in_between(prime, min_clustered, y);
+
+  int64_t l = l_high;
+  int64_t pi_min_clustered = max(pi[min_clustered], l_low);
+  int64_t pi_min_sparse = l_low;
+
+  if (is_libdivide(x2))
+  {
+    // Find all clustered easy leaves:
+    // n = primes[b] * primes[l]
+    // x / n <= y && phi(x / n, b - 1) == phi(x / m, b - 1)
+    // where phi(x / n, b - 1) = pi(x / n) - b + 2
+    while (l > pi_min_clustered)
+    {
+      int64_t xn = (uint64_t) x2 / fastdiv[l];
+      int64_t phi_xn = pi[xn] - b + 2;
+      int64_t xm = (uint64_t) x2 / fastdiv[b + phi_xn - 1];
+      int64_t l2 = max(pi[xm], l_low);
+      s2_easy += phi_xn * (l - l2);
+      l = l2;
+    }
+
+    // Find all sparse easy leaves:
+    // n = primes[b] * primes[l]
+    // x / n <= y && phi(x / n, b - 1) = pi(x / n) - b + 2
+    // The quotients x2 / primes[l] are independent of each
+    // other, we compute 4 of them per iteration so that
+    // the CPU can overlap the divisions and PiTable lookups.
+    uint64_t x2_64 = (uint64_t) x2;
+    int64_t sum = 0;
+
+    for (; l - 4 >= pi_min_sparse; l -= 4)
+    {
+      uint64_t xn0 = x2_64 / fastdiv[l];
+      uint64_t xn1 = x2_64 / fastdiv[l - 1];
+      uint64_t xn2 = x2_64 / fastdiv[l - 2];
+      uint64_t xn3 = x2_64 / fastdiv[l - 3];
+      sum += (pi[xn0] + pi[xn1]) + (pi[xn2] + pi[xn3]);
+      sum -= (b - 2) * 4;
+    }
+
+    for (; l > pi_min_sparse; l--)
+    {
+      int64_t xn = x2_64 / fastdiv[l];
+      sum += pi[xn] - b + 2;
+    }
+
+    s2_easy += sum;
+  }
+  else
+  {
+    // Find all clustered easy leaves:
+    // n = primes[b] * primes[l]
+    // x / n <= y && phi(x / n, b - 1) == phi(x / m, b - 1)
+    // where phi(x / n, b - 1) = pi(x / n) - b + 2
+    while (l > pi_min_clustered)
+    {
+      int64_t xn = fast_div(x2, l, primes, dividers);
+      int64_t phi_xn = pi[xn] - b + 2;
+      int64_t xm = fast_div(x2, b + phi_xn - 1, primes, dividers);
+      int64_t l2 = max(pi[xm], l_low);
+      s2_easy += phi_xn * (l - l2);
+      l = l2;
+    }
+
+    // Find all sparse easy leaves:
+    // n = primes[b] * primes[l]
+    // x / n <= y && phi(x / n, b - 1) = pi(x / n) - b + 2
+    for (; l > pi_min_sparse; l--)
+    {
+      int64_t xn = fast_div(x2, l, primes, dividers);
+      s2_easy += pi[xn] - b + 2;
+    }
+  }
+
+  return s2_easy;
+}
+
 /// Calculate the contribution of the clustered easy
 /// leaves and the sparse easy leaves.
 ///
@@ -62,6 +162,7 @@ T S2_easy_mpi_master(T x,
   int64_t x13 = iroot<3>(x);
   threads = ideal_num_threads(threads, x13, 1000);
   auto fastdiv = libdivide_vector(primes);
+  auto dividers = divider128_vector(x, primes);
 
   PiTable pi(y);
   int64_t pi_sqrty = pi[isqrt(y)];
@@ -71,75 +172,33 @@ T S2_easy_mpi_master(T x,
   int proc_id = mpi_proc_id();
   int procs = mpi_num_procs();
 
-  #pragma omp parallel for schedule(dynamic) num_threads(threads) reduction(+: s2_easy)
-  for (int64_t b = max(c, pi_sqrty) + 1 + proc_id; b <= pi_x13; b += procs)
-  {
-    int64_t prime = primes[b];
-    T x2 = x / prime;
-    int64_t min_trivial = min(x2 / prime, y);
-    int64_t min_clustered = (int64_t) isqrt(x2);
-    int64_t min_sparse = z / prime;
-
-    min_clustered = in_between(prime, min_clustered, y);
-    min_sparse = in_between(prime, min_sparse, y);
+  vector<S2EasyChunk> chunks;
+  int64_t b_start = max(c, pi_sqrty) + 1 + proc_id;
+  b_start = S2_easy_chunks(x, y, z, b_start, pi_x13, procs, threads, primes, pi, chunks);
 
-    int64_t l = pi[min_trivial];
-    int64_t pi_min_clustered = pi[min_clustered];
-    int64_t pi_min_sparse = pi[min_sparse];
+  #pragma omp parallel num_threads(threads) reduction(+: s2_easy)
+  {
+    bind_thread();
 
-    if (is_libdivide(x2))
+    // The primes with the most easy leaves
+    // are split into chunks of similar size
+    #pragma omp for schedule(dynamic) nowait
+    for (int64_t i = 0; i < (int64_t) chunks.size(); i++)
     {
-      // Find all clustered easy leaves:
-      // n = primes[b] * primes[l]
-      // x / n <= y && phi(x / n, b - 1) == phi(x / m, b - 1)
-      // where phi(x / n, b - 1) = pi(x / n) - b + 2
-      while (l > pi_min_clustered)
-      {
-        int64_t xn = (uint64_t) x2 / fastdiv[l];
-        int64_t phi_xn = pi[xn] - b + 2;
-        int64_t xm = (uint64_t) x2 / fastdiv[b + phi_xn - 1];
-        int64_t l2 = pi[xm];
-        s2_easy += phi_xn * (l - l2);
-        l = l2;
-      }
-
-      // Find all sparse easy leaves:
-      // n = primes[b] * primes[l]
-      // x / n <= y && phi(x / n, b - 1) = pi(x / n) - b + 2
-      for (; l > pi_min_sparse; l--)
-      {
-        int64_t xn = (uint64_t) x2 / fastdiv[l];
-        s2_easy += pi[xn] - b + 2;
-      }
+      auto& chunk = chunks[i];
+      s2_easy += S2_easy_leaves(x, y, chunk.b, chunk.l_high, chunk.l_low, primes, pi, fastdiv, dividers);
     }
-    else
+
+    #pragma omp for schedule(dynamic)
+    for (int64_t b = b_start; b <= pi_x13; b += procs)
     {
-      // Find all clustered easy leaves:
-      // n = primes[b] * primes[l]
-      // x / n <= y && phi(x / n, b - 1) == phi(x / m, b - 1)
-      // where phi(x / n, b - 1) = pi(x / n) - b + 2
-      while (l > pi_min_clustered)
-      {
-        int64_t xn = (int64_t) (x2 / primes[l]);
-        int64_t phi_xn = pi[xn] - b + 2;
-        int64_t xm = (int64_t) (x2 / primes[b + phi_xn - 1]);
-        int64_t l2 = pi[xm];
-        s2_easy += phi_xn * (l - l2);
-        l = l2;
-      }
-
-      // Find all sparse easy leaves:
-      // n = primes[b] * primes[l]
-      // x / n <= y && phi(x / n, b - 1) = pi(x / n) - b + 2
-      for (; l > pi_min_sparse; l--)
-      {
-        int64_t xn = (int64_t) (x2 / primes[l]);
-        s2_easy += pi[xn] - b + 2;
-      }
-    }
+      int64_t l_high, l_low;
+      S2_easy_range(x, y, z, b, primes, pi, &l_high, &l_low);
+      s2_easy += S2_easy_leaves(x, y, b, l_high, l_low, primes, pi, fastdiv, dividers);
 
-    if (is_print())
-      status.print(b, pi_x13);
+      if (is_print())
+        status.print(b, pi_x13);
+    }
   }
 
   s2_easy = mpi_reduce_sum(s2_easy);
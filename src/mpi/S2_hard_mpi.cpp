@@ -20,8 +20,10 @@
 ///
 
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <PiTable.hpp>
 #include <FactorTable.hpp>
+#include <Divider128.hpp>
 #include <fast_div.hpp>
 #include <generate.hpp>
 #include <generate_phi.hpp>
@@ -59,6 +61,7 @@ T S2_hard_thread(T x,
                  FactorTable& factor,
                  PiTable& pi,
                  Primes& primes,
+                 vector<Divider128>& dividers,
                  Runtime& runtime)
 {
   int64_t low1 = max(low, 1);
@@ -145,7 +148,7 @@ T S2_hard_thread(T x,
 
       for (; primes[l] > min_hard; l--)
       {
-        int64_t xn = (int64_t) fast_div(x2, primes[l]);
+        int64_t xn = fast_div(x2, l, primes, dividers);
         int64_t stop = xn - low;
         count += sieve.count(start, stop, low, high, count, count_low_high);
         start = stop + 1;
@@ -181,6 +184,10 @@ void S2_hard_slave(T x,
   int64_t max_prime = min(y, z / isqrt(y));
   PiTable pi(max_prime);
 
+  // if x > 2^64 precompute the reciprocals of the
+  // primes used in the hard special leaf divisions
+  auto dividers = divider128_vector(x, primes);
+
   MpiMsg msg;
   int master_proc_id = mpi_master_proc_id();
   int proc_id = mpi_proc_id();
@@ -188,6 +195,7 @@ void S2_hard_slave(T x,
   #pragma omp parallel for num_threads(threads)
   for (int i = 0; i < threads; i++)
   {
+    bind_thread();
     T s2_hard = 0;
     int64_t low = 0;
     int64_t segments = 0;
@@ -213,7 +221,7 @@ void S2_hard_slave(T x,
         break;
 
       runtime.start();
-      s2_hard = S2_hard_thread(x, y, z, c, low, segments, segment_size, factor, pi, primes, runtime);
+      s2_hard = S2_hard_thread(x, y, z, c, low, segments, segment_size, factor, pi, primes, dividers, runtime);
       runtime.stop();
     }
   }
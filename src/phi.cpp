@@ -10,8 +10,8 @@
 ///        to my implementation which significantly speed up the
 ///        calculation:
 ///
-///        * Cache results of phi(x, a)
-///        * Calculate phi(x, a) using formula [2] if a <= 6
+///        * Cache results of phi(x, a) (shared by all threads)
+///        * Calculate phi(x, a) using formula [2] if a <= 8
 ///        * Calculate phi(x, a) using pi(x) lookup table
 ///        * Calculate all phi(x, a) = 1 upfront
 ///        * Stop recursion at c instead of 1
@@ -22,7 +22,7 @@
 ///       [2] phi(x, a) = (x / pp) * φ(pp) + phi(x % pp, a)
 ///           with pp = 2 * 3 * ... * prime[a] 
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -30,6 +30,7 @@
 
 #include <PiTable.hpp>
 #include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
 #include <generate.hpp>
 #include <imath.hpp>
 #include <PhiTiny.hpp>
@@ -39,6 +40,7 @@
 #include <stdint.h>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <vector>
 #include <limits>
 
@@ -50,14 +52,60 @@ namespace {
 /// Cache phi(x, a) results if a < MAX_A
 const int MAX_A = 100;
 
+/// Default memory limit of the phi(x, a) cache, large
+/// enough to cache all x <= 65535 for all a < MAX_A.
+/// The cache memory is allocated lazily, hence the
+/// real memory usage is usually much smaller.
+///
+int64_t phi_cache_size_ = 32 << 20;
+
+/// The phi(x, a) cache is shared by all threads. Each
+/// phi(x, a) result is stored only once, the cache uses
+/// an insert-once protocol: a slot is either 0 (empty) or
+/// it contains phi(x, a) which is the same for all threads.
+/// Hence relaxed atomic loads and stores are sufficient.
+/// The rows are split into small chunks which are allocated
+/// lazily on first use (the first thread that installs a
+/// chunk wins), hence only the parts of the cache that are
+/// actually used consume memory.
+///
 class PhiCache
 {
 public:
-  PhiCache(vector<int32_t>& primes,
+  PhiCache(int64_t x,
+           int64_t a,
+           vector<int32_t>& primes,
            PiTable& pi) :
     primes_(primes),
     pi_(pi)
-  { }
+  {
+    max_a_ = min(a, MAX_A);
+    int64_t limit = phi_cache_size_ / (max_a_ * sizeof(T));
+    limit = min(limit, (int64_t) numeric_limits<T>::max());
+
+    // x / primes[i + 1] is the largest x that is
+    // passed to the recursive phi(x, i) function,
+    // hence the rows of large i are much shorter.
+    int64_t chunks = 0;
+
+    for (int64_t i = 0; i < max_a_; i++)
+    {
+      limit_[i] = min(limit, x / primes_[i + 1]);
+      offset_[i] = chunks;
+      chunks += (limit_[i] >> CHUNK_BITS) + 1;
+    }
+
+    chunks_ = vector<atomic<Chunk*>>(chunks);
+  }
+
+  ~PhiCache()
+  {
+    for (auto& chunk : chunks_)
+      delete chunk.load(memory_order_relaxed);
+  }
+
+  PhiCache(const PhiCache&) = delete;
+  PhiCache& operator=(const PhiCache&) = delete;
 
   /// Calculate phi(x, a) using the recursive formula:
   /// phi(x, a) = phi(x, a - 1) - phi(x / primes_[a], a - 1)
@@ -72,7 +120,7 @@ public:
     else if (is_pix(x, a))
       return (pi_[x] - a + 1) * SIGN;
     else if (is_cached(x, a))
-      return cache_[a][x] * SIGN;
+      return get_cache(x, a) * SIGN;
 
     int64_t sqrtx = isqrt(x);
     int64_t pi_sqrtx = a;
@@ -109,34 +157,62 @@ public:
   }
 
 private:
-  using T = uint16_t;
-  array<vector<T>, MAX_A> cache_;
+  using T = uint32_t;
+  enum { CHUNK_BITS = 8 };
+  using Chunk = array<atomic<T>, 1 << CHUNK_BITS>;
+  vector<atomic<Chunk*>> chunks_;
+  array<int64_t, MAX_A> offset_;
   vector<int32_t>& primes_;
   PiTable& pi_;
+  array<int64_t, MAX_A> limit_;
+  int64_t max_a_;
 
-  void update_cache(uint64_t x, uint64_t a, int64_t sum)
+  void update_cache(int64_t x, int64_t a, int64_t sum)
   {
-    if (a < cache_.size() &&
-        x <= numeric_limits<T>::max())
+    if (a < max_a_ &&
+        x <= limit_[a])
     {
-      if (x >= cache_[a].size())
-        cache_[a].resize(x + 1, 0);
+      auto& slot = chunks_[offset_[a] + (x >> CHUNK_BITS)];
+      Chunk* chunk = slot.load(memory_order_acquire);
+
+      if (!chunk)
+      {
+        Chunk* expected = nullptr;
+        chunk = new Chunk();
+        if (!slot.compare_exchange_strong(expected, chunk, memory_order_acq_rel))
+        {
+          delete chunk;
+          chunk = expected;
+        }
+      }
 
-      cache_[a][x] = (T) abs(sum);
+      T phi_xa = (T) abs(sum);
+      (*chunk)[x & ((1 << CHUNK_BITS) - 1)].store(phi_xa, memory_order_relaxed);
     }
   }
 
+  int64_t get_cache(int64_t x, int64_t a) const
+  {
+    auto& slot = chunks_[offset_[a] + (x >> CHUNK_BITS)];
+    Chunk* chunk = slot.load(memory_order_acquire);
+
+    if (!chunk)
+      return 0;
+
+    return (*chunk)[x & ((1 << CHUNK_BITS) - 1)].load(memory_order_relaxed);
+  }
+
   bool is_pix(int64_t x, int64_t a) const
   {
     return x < pi_.size() &&
            x < isquare(primes_[a + 1]);
   }
 
-  bool is_cached(uint64_t x, uint64_t a) const
+  bool is_cached(int64_t x, int64_t a) const
   {
-    return a < cache_.size() && 
-           x < cache_[a].size() && 
-           cache_[a][x];
+    return a < max_a_ &&
+           x <= limit_[a] &&
+           get_cache(x, a);
   }
 };
 
@@ -144,6 +220,17 @@ private:
 
 namespace primecount {
 
+/// Set the memory limit of the phi(x, a) cache in bytes
+void set_phi_cache_size(int64_t bytes)
+{
+  phi_cache_size_ = max(bytes, (int64_t) 0);
+}
+
+int64_t get_phi_cache_size()
+{
+  return phi_cache_size_;
+}
+
 /// Partial sieve function (a.k.a. Legendre-sum).
 /// phi(x, a) counts the numbers <= x that are not divisible
 /// by any of the first a primes.
@@ -169,18 +256,24 @@ int64_t phi(int64_t x, int64_t a, int threads)
       // use large pi(x) lookup table for speed
       int64_t sqrtx = isqrt(x);
       PiTable pi(max(sqrtx, primes[a]));
-      PhiCache cache(primes, pi);
+      PhiCache cache(x, a, primes, pi);
 
       int64_t c = PhiTiny::get_c(sqrtx);
       int64_t pi_sqrtx = min(pi[sqrtx], a);
-      int64_t thread_threshold = ipow(10ll, 10);
+      int64_t thread_threshold = ipow(10ll, 7);
       threads = ideal_num_threads(threads, x, thread_threshold);
 
       sum = phi_tiny(x, c) - a + pi_sqrtx;
 
-      #pragma omp parallel for num_threads(threads) schedule(dynamic, 16) firstprivate(cache) reduction(+: sum)
+      // The first few phi(x / primes[i + 1], i) computations
+      // are by far the most expensive ones, hence they are
+      // distributed one at a time to the threads.
+      #pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+: sum)
       for (int64_t i = c; i < pi_sqrtx; i++)
+      {
+        bind_thread();
         sum += cache.phi<-1>(x / primes[i + 1], i);
+      }
     }
   }
 
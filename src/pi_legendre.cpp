@@ -1,7 +1,7 @@
 ///
 /// @file  pi_legendre.cpp
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -23,7 +23,7 @@ int64_t pi_legendre(int64_t x, int threads)
   if (x < 2)
     return 0;
 
-  int64_t a = pi_legendre(isqrt(x), 1);
+  int64_t a = pi_legendre(isqrt(x), threads);
   int64_t sum = phi(x, a, threads) + a - 1;
 
   return sum;
@@ -1,7 +1,7 @@
 ///
 /// @file  pi_meissel.cpp
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -26,7 +26,7 @@ int64_t pi_meissel(int64_t x, int threads)
     return 0;
 
   int64_t y = iroot<3>(x);
-  int64_t a = pi_legendre(y);
+  int64_t a = pi_legendre(y, threads);
 
   print("");
   print("=== pi_meissel(x) ===");
@@ -2,7 +2,7 @@
 /// @file  primecount.cpp
 /// @brief Function definitions of primecount.hpp
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -11,9 +11,12 @@
 #include <primecount.hpp>
 #include <primecount-internal.hpp>
 #include <primesieve.hpp>
+#include <primesieve/CpuInfo.hpp>
 #include <calculator.hpp>
+#include <CpuAffinity.hpp>
 #include <int128_t.hpp>
 #include <imath.hpp>
+#include <print.hpp>
 
 #include <algorithm>
 #include <chrono>
@@ -73,6 +76,12 @@ int status_precision_ = -1;
 
 double alpha_ = -1;
 
+// Sieve array size in bytes, 0 = use detected cache size
+int64_t cache_size_ = 0;
+
+// CPU cache level the sieve array should fit into
+int cache_level_ = 1;
+
 // Below 10^7 LMO is faster than Deleglise-Rivat
 const int lmo_threshold = 10000000;
 
@@ -293,6 +302,91 @@ double get_alpha_deleglise_rivat(maxint_t x)
   return in_between(1, alpha, iroot<6>(x));
 }
 
+void set_cache_size(int64_t bytes)
+{
+  cache_size_ = max(bytes, (int64_t) 0);
+}
+
+void set_cache_level(int level)
+{
+  if (level < 1 || level > 2)
+    throw primecount_error("cache level must be 1 or 2");
+
+  cache_level_ = level;
+}
+
+/// Size in bytes of the CPU cache the sieve array of the
+/// hard special leaves algorithm should fit into. The L1
+/// data cache is the default because that is what
+/// primecount has always used, --cache_level=2 selects
+/// the L2 cache instead.
+///
+int64_t get_cache_size()
+{
+  if (cache_size_ > 0)
+    return cache_size_;
+
+  // if threads are pinned, use the cache
+  // size of the calling thread's CPU core
+  int64_t size = (cache_level_ == 2)
+      ? thread_l2_cache_size()
+      : thread_l1_cache_size();
+
+  if (size > 0)
+    return size;
+
+  using primesieve::cpuInfo;
+
+  if (cache_level_ == 2 && cpuInfo.hasL2Cache())
+    size = (int64_t) cpuInfo.l2CacheSize();
+  else if (cpuInfo.hasL1Cache())
+    size = (int64_t) cpuInfo.l1CacheSize();
+
+  // default L1 data cache size
+  if (size < (1 << 12))
+    size = 1 << 15;
+
+  return size;
+}
+
+Settings get_settings()
+{
+  Settings settings;
+#ifdef _OPENMP
+  settings.threads = threads_;
+#else
+  settings.threads = 1;
+#endif
+  settings.alpha = alpha_;
+  settings.cache_size = cache_size_;
+  settings.cache_level = cache_level_;
+  settings.phi_cache_size = get_phi_cache_size();
+  settings.affinity = get_affinity();
+  settings.status_precision = status_precision_;
+  settings.print = is_print();
+  settings.print_variables = print_variables();
+  return settings;
+}
+
+void set_settings(const Settings& settings)
+{
+#ifdef _OPENMP
+  threads_ = settings.threads;
+#endif
+  primesieve::set_num_threads(get_num_threads());
+  alpha_ = settings.alpha;
+  cache_size_ = settings.cache_size;
+  cache_level_ = settings.cache_level;
+  set_phi_cache_size(settings.phi_cache_size);
+  status_precision_ = settings.status_precision;
+  set_print(settings.print);
+  set_print_variables(settings.print_variables);
+
+  // creating a CpuAffinity is not free
+  if (settings.affinity != get_affinity())
+    set_affinity(settings.affinity);
+}
+
 void set_num_threads(int threads)
 {
 #ifdef _OPENMP
@@ -3,7 +3,7 @@
 /// @brief  Test the offset logarithmic integral function
 ///         Li(x) = li(x) - li(2)
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -11,6 +11,7 @@
 
 #include <primecount-internal.hpp>
 #include <imath.hpp>
+#include <int128_t.hpp>
 
 #include <stdint.h>
 #include <iostream>
@@ -48,6 +49,39 @@ void check(bool OK)
     exit(1);
 }
 
+#ifdef HAVE_INT128_T
+
+/// Without __float128 Li(x) and Ri(x) use long double
+/// precision, hence the results are only approximate
+/// for x > 2^64.
+///
+bool is_close(int128_t res, int128_t correct)
+{
+#if defined(HAVE_FLOAT128)
+  return res == correct;
+#else
+  int128_t diff = (res > correct) ? res - correct : correct - res;
+  return diff <= correct / ipow((int128_t) 10, 12);
+#endif
+}
+
+/// For x > 10^33 (x > 10^19 without __float128) Li(x)
+/// uses the asymptotic expansion of li(x) whose result
+/// is accurate to about 32 digits (12 digits).
+///
+bool is_close_asymptotic(int128_t res, int128_t correct)
+{
+#if defined(HAVE_FLOAT128)
+  int128_t digits = ipow((int128_t) 10, 31);
+#else
+  int128_t digits = ipow((int128_t) 10, 12);
+#endif
+  int128_t diff = (res > correct) ? res - correct : correct - res;
+  return diff <= correct / digits;
+}
+
+#endif
+
 int main()
 {
   size_t size = 15;
@@ -72,6 +106,48 @@ int main()
           Li_inverse(Li_table[i] + 1) > x);
   }
 
+#ifdef HAVE_INT128_T
+
+  {
+    int128_t x = ipow((int128_t) 10, 24);
+    int128_t Li_x = to_maxint("18435599767366347775143");
+    int128_t res = Li(x);
+    cout << "Li(" << x << ") = " << res;
+    check(is_close(res, Li_x));
+
+    x = ipow((int128_t) 10, 30);
+    Li_x = to_maxint("14692398897720447639079087668");
+    res = Li(x);
+    cout << "Li(" << x << ") = " << res;
+    check(is_close(res, Li_x));
+
+    res = Li_inverse(Li_x);
+    cout << "Li_inverse(" << Li_x << ") = " << res;
+#if defined(HAVE_FLOAT128)
+    check(res <= x && Li_inverse(Li_x + 1) > x);
+#else
+    check(is_close(res, x));
+#endif
+
+    x = ipow((int128_t) 10, 35);
+    Li_x = to_maxint("1256635328818316477984258713989888");
+    res = Li(x);
+    cout << "Li(" << x << ") = " << res;
+    check(is_close_asymptotic(res, Li_x));
+
+    x = ipow((int128_t) 10, 36);
+    Li_x = to_maxint("12212914297619365454914525220396541");
+    res = Li(x);
+    cout << "Li(" << x << ") = " << res;
+    check(is_close_asymptotic(res, Li_x));
+
+    res = Li_inverse(Li_x);
+    cout << "Li_inverse(" << Li_x << ") = " << res;
+    check(is_close_asymptotic(res, x));
+  }
+
+#endif
+
   cout << endl;
   cout << "All tests passed successfully!" << endl;
 
@@ -2,7 +2,7 @@
 /// @file   RiemannR.cpp
 /// @brief  Test the Riemann R function
 ///
-/// Copyright (C) 2018 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -10,6 +10,7 @@
 
 #include <primecount-internal.hpp>
 #include <imath.hpp>
+#include <int128_t.hpp>
 
 #include <stdint.h>
 #include <iostream>
@@ -44,6 +45,24 @@ void check(bool OK)
     exit(1);
 }
 
+#ifdef HAVE_INT128_T
+
+/// Without __float128 Li(x) and Ri(x) use long double
+/// precision, hence the results are only approximate
+/// for x > 2^64.
+///
+bool is_close(int128_t res, int128_t correct)
+{
+#if defined(HAVE_FLOAT128)
+  return res == correct;
+#else
+  int128_t diff = (res > correct) ? res - correct : correct - res;
+  return diff <= correct / ipow((int128_t) 10, 12);
+#endif
+}
+
+#endif
+
 int main()
 {
   for (size_t i = 0; i < Ri_table.size(); i++)
@@ -63,6 +82,32 @@ int main()
           Ri_inverse(Ri_table[i] + 1) >= x);
   }
 
+#ifdef HAVE_INT128_T
+
+  {
+    int128_t x = ipow((int128_t) 10, 24);
+    int128_t Ri_x = to_maxint("18435599767347541878146");
+    int128_t res = Ri(x);
+    cout << "Ri(" << x << ") = " << res;
+    check(is_close(res, Ri_x));
+
+    x = ipow((int128_t) 10, 30);
+    Ri_x = to_maxint("14692398897720432716641650390");
+    res = Ri(x);
+    cout << "Ri(" << x << ") = " << res;
+    check(is_close(res, Ri_x));
+
+    res = Ri_inverse(Ri_x);
+    cout << "Ri_inverse(" << Ri_x << ") = " << res;
+#if defined(HAVE_FLOAT128)
+    check(res < x && Ri_inverse(Ri_x + 1) >= x);
+#else
+    check(is_close(res, x));
+#endif
+  }
+
+#endif
+
   cout << endl;
   cout << "All tests passed successfully!" << endl;
 
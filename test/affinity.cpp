@@ -0,0 +1,131 @@
+///
+/// @file   affinity.cpp
+/// @brief  Test that changing the thread affinity (like batch
+///         mode does between its commands) restores the CPU
+///         affinity of the process before pinning the threads
+///         again.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <primecount.hpp>
+#include <primecount-internal.hpp>
+#include <CpuAffinity.hpp>
+
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+#if defined(__linux__)
+  #include <sched.h>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+using namespace std;
+using namespace primecount;
+
+void check(bool OK)
+{
+  cout << "   " << (OK ? "OK" : "ERROR") << "\n";
+  if (!OK)
+    exit(1);
+}
+
+#if defined(__linux__)
+
+cpu_set_t get_mask()
+{
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  sched_getaffinity(0, sizeof(mask), &mask);
+  return mask;
+}
+
+/// Check that the calling thread and all threads
+/// of a parallel region are no longer pinned.
+///
+bool is_unpinned(const cpu_set_t& process_mask)
+{
+  int unpinned = 1;
+  cpu_set_t mask = get_mask();
+  if (!CPU_EQUAL(&mask, &process_mask))
+    unpinned = 0;
+
+  int threads = get_num_threads();
+
+  #pragma omp parallel for num_threads(threads) reduction(&: unpinned)
+  for (int i = 0; i < threads; i++)
+  {
+    bind_thread();
+    cpu_set_t thread_mask = get_mask();
+    if (!CPU_EQUAL(&thread_mask, &process_mask))
+      unpinned = 0;
+  }
+
+  return unpinned != 0;
+}
+
+int main()
+{
+  cpu_set_t process_mask = get_mask();
+  Settings settings = get_settings();
+
+  // first CPU core the process may run on
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &process_mask))
+    cpu++;
+
+  string cpu_list = to_string(cpu);
+  string affinities[] = { cpu_list, "compact", "scatter", cpu_list, "none", "compact" };
+  int64_t x = 100000000;
+  int64_t pix = 5761455;
+
+  for (const string& affinity : affinities)
+  {
+    set_settings(settings);
+
+    cout << "set_settings() before --affinity=" << affinity << " = unpinned";
+    check(is_unpinned(process_mask));
+
+    set_affinity(affinity);
+    int64_t res = pi(x);
+    cout << "pi(" << x << ") --affinity=" << affinity << " = " << res;
+    check(res == pix);
+  }
+
+  set_settings(settings);
+  cout << "set_settings() = unpinned";
+  check(is_unpinned(process_mask));
+
+  set_affinity(cpu_list);
+  bind_thread();
+  cpu_set_t mask = get_mask();
+  cout << "--affinity=" << cpu_list << " pins the calling thread";
+  check(CPU_COUNT(&mask) == 1 && CPU_ISSET(cpu, &mask));
+
+  set_affinity("none");
+  cout << "--affinity=none = unpinned";
+  check(is_unpinned(process_mask));
+
+  cout << endl;
+  cout << "All tests passed successfully!" << endl;
+
+  return 0;
+}
+
+#else
+
+int main()
+{
+  cout << "Thread affinity is only supported on Linux" << endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#
+# Test the primecount --batch mode. The batch commands use
+# different --affinity options, each command must start
+# with the CPU affinity of the process restored (instead
+# of the affinity of the previous command).
+#
+# Usage: cmake -DPRIMECOUNT=<binary> -DWORK_DIR=<dir> -P batch.cmake
+#
+
+# Get 2 CPU cores the process is allowed to run on
+set(cpu1 0)
+set(cpu2 0)
+file(STRINGS /proc/self/status cpus REGEX "^Cpus_allowed_list:")
+string(REGEX REPLACE "^Cpus_allowed_list:[ \t]*" "" cpus "${cpus}")
+string(REPLACE "," ";" cpus "${cpus}")
+list(GET cpus 0 first)
+
+if(first MATCHES "^([0-9]+)-([0-9]+)$")
+    set(cpu1 ${CMAKE_MATCH_1})
+    math(EXPR cpu2 "${cpu1} + 1")
+elseif(first MATCHES "^([0-9]+)$")
+    set(cpu1 ${CMAKE_MATCH_1})
+    set(cpu2 ${cpu1})
+    list(LENGTH cpus size)
+    if(size GREATER 1)
+        list(GET cpus 1 second)
+        string(REGEX REPLACE "-.*" "" cpu2 "${second}")
+    endif()
+endif()
+
+set(batch_file "${WORK_DIR}/batch_affinity.txt")
+set(results_file "${batch_file}.results")
+file(REMOVE "${results_file}")
+file(WRITE "${batch_file}"
+     "# pi(x) using different thread affinities\n"
+     "1e10 --affinity=${cpu1}\n"
+     "1e11 --affinity=${cpu2}\n"
+     "1e11 --affinity=compact\n"
+     "1e11 --affinity=scatter\n"
+     "1e12 --affinity=none\n"
+     "1e12\n")
+
+execute_process(COMMAND "${PRIMECOUNT}" "--batch=${batch_file}"
+                RESULT_VARIABLE status
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE output)
+
+message("${output}")
+
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "primecount --batch failed: ${status}")
+endif()
+
+file(READ "${results_file}" results)
+
+foreach(row "1e10 --affinity=${cpu1}\t455052511\t"
+            "1e11 --affinity=${cpu2}\t4118054813\t"
+            "1e11 --affinity=compact\t4118054813\t"
+            "1e11 --affinity=scatter\t4118054813\t"
+            "1e12 --affinity=none\t37607912018\t"
+            "1e12\t37607912018\t")
+    string(FIND "${results}" "${row}" pos)
+    if(pos EQUAL -1)
+        message(FATAL_ERROR "Missing result: ${row}\n${results}")
+    endif()
+endforeach()
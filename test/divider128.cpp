@@ -0,0 +1,87 @@
+///
+/// @file  divider128.cpp
+/// @brief Test Divider128 class
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <Divider128.hpp>
+#include <int128_t.hpp>
+
+#include <stdint.h>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+
+using namespace std;
+using namespace primecount;
+
+void check(bool OK)
+{
+  cout << "   " << (OK ? "OK" : "ERROR") << "\n";
+  if (!OK)
+    exit(1);
+}
+
+int main()
+{
+  random_device rd;
+  mt19937 gen(rd());
+
+  uniform_int_distribution<uint32_t> dist_u32(1, numeric_limits<uint32_t>::max());
+  uniform_int_distribution<uint64_t> dist_u64(1, numeric_limits<uint64_t>::max());
+
+  for (int i = 0; i < 1000; i++)
+  {
+    uint64_t x = dist_u64(gen);
+    uint64_t d = dist_u32(gen);
+    Divider128 divider(d);
+    uint64_t res = divider.divide(x);
+
+    cout << x << " / " << d << " = " << res;
+    check(res == x / d);
+  }
+
+#ifdef HAVE_INT128_T
+
+  for (int i = 0; i < 1000; i++)
+  {
+    // x / d < 2^64
+    uint64_t d = (i % 2) ? dist_u32(gen) : dist_u64(gen);
+    uint64_t high = dist_u64(gen) % d;
+    uint128_t x = ((uint128_t) high << 64) | dist_u64(gen);
+    Divider128 divider(d);
+    uint64_t res = divider.divide(x);
+
+    cout << x << " / " << d << " = " << res;
+    check(res == x / d);
+
+    int128_t y = (int128_t) (x >> 1);
+    res = divider.divide(y);
+
+    cout << y << " / " << d << " = " << res;
+    check(res == (uint128_t) y / d);
+  }
+
+  // Largest quotient: (d * 2^64 - 1) / d
+  for (uint64_t d = 1; d < 100; d++)
+  {
+    uint128_t x = ((uint128_t) d << 64) - 1;
+    Divider128 divider(d);
+    uint64_t res = divider.divide(x);
+
+    cout << x << " / " << d << " = " << res;
+    check(res == x / d);
+  }
+
+#endif
+
+  cout << endl;
+  cout << "All tests passed successfully!" << endl;
+
+  return 0;
+}
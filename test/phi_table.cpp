@@ -0,0 +1,79 @@
+///
+/// @file  phi_table.cpp
+/// @brief Test the PhiTable class, a lookup table of phi(x, a)
+///        results for small x.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <PhiTable.hpp>
+#include <PhiTiny.hpp>
+#include <generate.hpp>
+
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace primecount;
+
+void check(bool OK)
+{
+  cout << "   " << (OK ? "OK" : "ERROR") << "\n";
+  if (!OK)
+    exit(1);
+}
+
+int main()
+{
+  random_device rd;
+  mt19937 gen(rd());
+  uniform_int_distribution<int> dist(0, (int) PhiTable::max_x());
+
+  const PhiTable& phiTable = get_phi_table();
+  int64_t max_x = PhiTable::max_x();
+  auto primes = generate_n_primes<int>(PhiTable::max_a());
+  vector<char> sieve(max_x + 1, 1);
+  vector<int> phi(max_x + 1, 0);
+  sieve[0] = 0;
+
+  for (int64_t a = 1; a <= PhiTable::max_a(); a++)
+  {
+    // remove primes[a] and its multiples
+    for (int64_t j = primes[a]; j <= max_x; j += primes[a])
+      sieve[j] = 0;
+
+    if (a <= PhiTiny::max_a())
+    {
+      cout << "is_cached(" << max_x << ", " << a << ")";
+      check(!phiTable.is_cached(max_x, a));
+      continue;
+    }
+
+    for (int64_t x = 1; x <= max_x; x++)
+      phi[x] = phi[x - 1] + sieve[x];
+
+    for (int i = 0; i < 100; i++)
+    {
+      int64_t x = dist(gen);
+      cout << "phi(" << x << ", " << a << ") = " << phiTable.phi(x, a);
+      check(phiTable.phi(x, a) == phi[x]);
+    }
+
+    cout << "phi(" << max_x << ", " << a << ") = " << phiTable.phi(max_x, a);
+    check(phiTable.phi(max_x, a) == phi[max_x]);
+  }
+
+  cout << "is_cached(" << max_x + 1 << ", " << 50 << ")";
+  check(!phiTable.is_cached(max_x + 1, 50));
+
+  cout << endl;
+  cout << "All tests passed successfully!" << endl;
+
+  return 0;
+}
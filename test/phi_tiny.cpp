@@ -2,9 +2,9 @@
 /// @file   phi_tiny.cpp
 /// @brief  Test the partial sieve function phi_tiny(x, a)
 ///         which counts the numbers <= x that are not divisible
-///         by any of the first a primes with a <= 6.
+///         by any of the first a primes with a <= 8.
 ///
-/// Copyright (C) 2017 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -14,6 +14,7 @@
 #include <generate.hpp>
 
 #include <stdint.h>
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <vector>
@@ -44,7 +45,8 @@ int main()
 {
   random_device rd;
   mt19937 gen(rd());
-  uniform_int_distribution<int> dist(10000000, 20000000);
+  // size > 2 * (2 * 3 * 5 * 7 * 11 * 13 * 17 * 19)
+  uniform_int_distribution<int> dist(20000000, 30000000);
 
   int64_t max_a = PhiTiny::max_a();
   int64_t size = dist(gen);
@@ -52,6 +54,8 @@ int main()
 
   auto primes = generate_n_primes<int>(max_a);
   vector<char> sieve(size, 1);
+  uniform_int_distribution<int64_t> dist_x(0, x);
+  int64_t pp = 1;
 
   for (int a = 1; a <= max_a; a++)
   {
@@ -61,6 +65,56 @@ int main()
 
     cout << "phi_tiny(" << x << ", " << a << ") = " << phi_tiny(x, a);
     check(phi_tiny(x, a) == count(sieve));
+
+    // test random x and the x next to the
+    // multiples of pp = 2 * 3 * ... * primes[a]
+    pp *= primes[a];
+    vector<int64_t> xs;
+
+    for (int i = 0; i < 100; i++)
+      xs.push_back(dist_x(gen));
+
+    for (int64_t k = 1; k <= 2 && k * pp + 1 <= x; k++)
+    {
+      xs.push_back(k * pp - 1);
+      xs.push_back(k * pp);
+      xs.push_back(k * pp + 1);
+    }
+
+    sort(xs.begin(), xs.end());
+    int64_t cnt = 0;
+    size_t i = 0;
+
+    for (int64_t n = 0; i < xs.size(); n++)
+    {
+      if (n > 0)
+        cnt += sieve[n];
+
+      for (; i < xs.size() && xs[i] == n; i++)
+      {
+        cout << "phi_tiny(" << n << ", " << a << ") = " << phi_tiny(n, a);
+        check(phi_tiny(n, a) == cnt);
+      }
+    }
+  }
+
+  // test the batch version of phi_tiny()
+  uniform_int_distribution<uint64_t> dist64(0, 1ull << 62);
+  vector<uint64_t> xs(1000);
+  vector<uint64_t> phi(xs.size());
+
+  for (auto& n : xs)
+    n = dist64(gen);
+
+  for (int a = 0; a <= max_a; a++)
+  {
+    phi_tiny(xs.data(), xs.size(), a, phi.data());
+
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+      cout << "phi_tiny(" << xs[i] << ", " << a << ") = " << phi[i];
+      check(phi[i] == phi_tiny(xs[i], a));
+    }
   }
 
   cout << endl;
@@ -3,7 +3,7 @@
 /// @brief  Test the PiTable class
 /// @link   https://en.wikipedia.org/wiki/Prime-counting_function
 ///
-/// Copyright (C) 2017 Kim Walisch, <kim.walisch@gmail.com>
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
 ///
 /// This file is distributed under the BSD License. See the COPYING
 /// file in the top level directory.
@@ -13,6 +13,7 @@
 #include <primesieve.hpp>
 
 #include <stdint.h>
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <vector>
@@ -72,6 +73,19 @@ int main()
     check(pi[n] == (int64_t) primesieve::count_primes(0, n));
   }
 
+  for (int i = 0; i < 10000; i++)
+  {
+    uint64_t n = dist(gen) % pi.size();
+    uint64_t next = primesieve::iterator(max(n, (uint64_t) 1) - 1).next_prime();
+    if (next >= (uint64_t) pi.size())
+      next = 0;
+    cout << "next_prime(" << n << ") = " << pi.next_prime(n);
+    check(pi.next_prime(n) == next);
+  }
+
+  cout << "next_prime(" << pi.size() << ") = " << pi.next_prime(pi.size());
+  check(pi.next_prime(pi.size()) == 0);
+
   cout << endl;
   cout << "All tests passed successfully!" << endl;
 
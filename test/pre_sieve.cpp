@@ -0,0 +1,70 @@
+///
+/// @file  pre_sieve.cpp
+/// @brief Test Sieve::pre_sieve(c, low, high) which removes
+///        the multiples of the first c primes.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <Sieve.hpp>
+
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace primecount;
+
+void check(bool OK)
+{
+  cout << "   " << (OK ? "OK" : "ERROR") << "\n";
+  if (!OK)
+    exit(1);
+}
+
+int main()
+{
+  random_device rd;
+  mt19937 gen(rd());
+  uniform_int_distribution<int> dist(0, 1000000);
+
+  vector<int> primes = { 0, 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+  for (int c = 0; c < (int) primes.size(); c++)
+  {
+    uint64_t low = dist(gen) * 30;
+    uint64_t segment_size = Sieve::get_segment_size(dist(gen) % 100000);
+    uint64_t segments = 5;
+    uint64_t limit = low + segment_size * segments - dist(gen) % segment_size;
+
+    Sieve sieve(low, segment_size, primes.size());
+
+    for (; low < limit; low += segment_size)
+    {
+      uint64_t high = min(low + segment_size, limit);
+      sieve.pre_sieve(c, low, high);
+      uint64_t count = 0;
+
+      for (uint64_t n = low; n < high; n++)
+      {
+        bool is_coprime = (n % 2) && (n % 3) && (n % 5);
+        for (int i = 4; i <= c; i++)
+          is_coprime = is_coprime && (n % primes[i]);
+        count += is_coprime;
+      }
+
+      cout << "pre_sieve(" << c << ", " << low << ", " << high << ") count = " << count;
+      check(count == sieve.count((high - 1) - low));
+    }
+  }
+
+  cout << endl;
+  cout << "All tests passed successfully!" << endl;
+
+  return 0;
+}
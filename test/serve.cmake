@@ -0,0 +1,65 @@
+#
+# Test the primecount --serve mode: send JSON requests
+# (one per line) to stdin and check the JSON responses,
+# including the escape sequences of the echoed id.
+#
+# Usage: cmake -DPRIMECOUNT=<binary> -DWORK_DIR=<dir> -P serve.cmake
+#
+
+set(requests_file "${WORK_DIR}/serve_requests.txt")
+
+file(WRITE "${requests_file}"
+     "{\"id\": 1, \"method\": \"pi\", \"x\": \"1e10\"}\n"
+     "\n"
+     "{\"id\": \"a\\\"b\\\\c\\/d\", \"method\": \"nth_prime\", \"x\": 100000, \"threads\": 1}\n"
+     "{\"id\": \"\\n\\t\\r\\b\\f\\u0041\\u001f\", \"method\": \"phi\", \"x\": 1000, \"a\": 3}\n"
+     "{\"id\": \"\\ud83d\\ude00\", \"method\": \"Li\", \"x\": \"1e10\"}\n"
+     "{\"id\": 5, \"method\": \"nope\", \"x\": 1}\n"
+     "{\"id\": 6, \"method\": \"phi\", \"x\": 1000}\n"
+     "{\"method\": \"pi\", \"x\": \"1e3\\q\"}\n"
+     "{\"method\": \"pi\", \"x\": \"\\ud800\"}\n")
+
+execute_process(COMMAND "${PRIMECOUNT}" --serve
+                INPUT_FILE "${requests_file}"
+                RESULT_VARIABLE status
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE error)
+
+message("${output}${error}")
+
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "primecount --serve failed: ${status}")
+endif()
+
+# The responses must be in the order of the requests
+set(expected
+    "{\"id\": 1, \"result\": \"455052511\", \"seconds\": "
+    "{\"id\": \"a\\\"b\\\\c/d\", \"result\": \"1299709\", \"seconds\": "
+    "{\"id\": \"\\n\\t\\r\\b\\fA\\u001f\", \"result\": \"266\", \"seconds\": "
+    "\", \"result\": \"455055613\", \"seconds\": "
+    "{\"id\": 5, \"error\": \"unknown method nope\"}"
+    "{\"id\": 6, \"error\": \"missing a\"}"
+    "{\"error\": \"invalid JSON request: "
+    "{\"error\": \"invalid JSON request: ")
+
+string(REGEX REPLACE "\n$" "" output "${output}")
+string(REPLACE ";" "\\;" output "${output}")
+string(REPLACE "\n" ";" responses "${output}")
+
+list(LENGTH expected size1)
+list(LENGTH responses size2)
+
+if(NOT size1 EQUAL size2)
+    message(FATAL_ERROR "Expected ${size1} responses, got ${size2}")
+endif()
+
+math(EXPR last "${size1} - 1")
+
+foreach(i RANGE ${last})
+    list(GET expected ${i} exp)
+    list(GET responses ${i} res)
+    string(FIND "${res}" "${exp}" pos)
+    if(pos EQUAL -1)
+        message(FATAL_ERROR "Response ${i}: ${res}\nexpected: ${exp}")
+    endif()
+endforeach()
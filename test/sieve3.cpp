@@ -0,0 +1,88 @@
+///
+/// @file   sieve3.cpp
+/// @brief  Test Sieve::cross_off(prime) using many small
+///         segments so that most sieving primes are larger
+///         than the segment size (these are stored in buckets).
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <Sieve.hpp>
+#include <generate.hpp>
+#include <imath.hpp>
+
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace primecount;
+
+void check(bool OK)
+{
+  cout << "   " << (OK ? "OK" : "ERROR") << "\n";
+  if (!OK)
+    exit(1);
+}
+
+int main()
+{
+  random_device rd;
+  mt19937 gen(rd());
+  uniform_int_distribution<int> dist(1000000, 2000000);
+
+  int64_t start = (dist(gen) % 2) ? 0 : dist(gen) / 30 * 30;
+  int64_t limit = start + dist(gen) * 2;
+  int64_t segment_size = Sieve::get_segment_size(dist(gen) % 1000);
+
+  auto primes = generate_primes<int64_t>(isqrt(limit));
+  Sieve sieve(start, segment_size, primes.size());
+
+  for (int64_t low = start; low < limit; low += segment_size)
+  {
+    int64_t high = min(low + segment_size, limit);
+    vector<int> sieve2(high - low);
+
+    for (int64_t n = low; n < high; n++)
+      sieve2[n - low] = (n % 2) && (n % 3) && (n % 5);
+
+    sieve.pre_sieve(3, low, high);
+
+    for (size_t i = 4; i < primes.size(); i++)
+    {
+      int64_t prime = primes[i];
+      int64_t cnt1 = sieve.cross_off(i, prime);
+      int64_t cnt2 = 0;
+      int64_t j = max((low + prime - 1) / prime * prime, prime);
+
+      for (; j < high; j += prime)
+      {
+        cnt2 += sieve2[j - low];
+        sieve2[j - low] = 0;
+      }
+
+      if (cnt1 != cnt2)
+      {
+        cout << "sieve.cross_off(" << i << ", " << prime << ") = " << cnt1;
+        check(false);
+      }
+    }
+
+    int64_t count = 0;
+    for (int x : sieve2)
+      count += x;
+
+    cout << "sieve.count(0, " << (high - 1) - low << ") = " << count;
+    check(count == (int64_t) sieve.count((high - 1) - low));
+  }
+
+  cout << endl;
+  cout << "All tests passed successfully!" << endl;
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+///
+/// @file   table_cache.cpp
+/// @brief  Test the LRU cache of the lookup tables (primes,
+///         PiTable, FactorTable) which are keyed by y.
+///
+/// Copyright (C) 2019 Kim Walisch, <kim.walisch@gmail.com>
+///
+/// This file is distributed under the BSD License. See the COPYING
+/// file in the top level directory.
+///
+
+#include <primecount.hpp>
+#include <primecount-internal.hpp>
+#include <TableCache.hpp>
+#include <PiTable.hpp>
+
+#include <stdint.h>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace primecount;
+
+void check(bool OK)
+{
+  cout << "   " << (OK ? "OK" : "ERROR") << "\n";
+  if (!OK)
+    exit(1);
+}
+
+int creates = 0;
+
+shared_ptr<const vector<int>> get_vector(int64_t y, int64_t limit)
+{
+  return get_table<vector<int>>(y, limit, [&]() {
+    creates++;
+    return vector<int>((size_t) limit, (int) y);
+  });
+}
+
+int main()
+{
+  cout << "cache disabled by default";
+  check(get_table_cache_size() == 0);
+
+  auto v1 = get_vector(1, 10);
+  auto v2 = get_vector(1, 10);
+  cout << "disabled cache creates new tables";
+  check(creates == 2 && v1 != v2);
+
+  set_table_cache_size(2);
+  creates = 0;
+  v1 = get_vector(1, 10);
+  v2 = get_vector(1, 10);
+  cout << "cached table of y = 1";
+  check(creates == 1 && v1 == v2 && v1->size() == 10);
+
+  // different limit (or type) of the same y
+  auto v3 = get_vector(1, 20);
+  auto pi_table = get_table<PiTable>(1, 20, [&]() { creates++; return PiTable(20); });
+  cout << "cached tables of y = 1 with other limit and type";
+  check(creates == 3 && v3 != v1 && v3->size() == 20 && (*pi_table)[20] == 8);
+
+  // y = 1 is the most recently used, hence
+  // inserting y = 3 evicts y = 2
+  get_vector(2, 10);
+  get_vector(1, 10);
+  get_vector(3, 10);
+  cout << "LRU: y = 1 still cached";
+  check(get_vector(1, 10) == v1 && creates == 5);
+  cout << "LRU: y = 2 evicted";
+  get_vector(2, 10);
+  check(creates == 6);
+
+  // an evicted table stays alive while it is used
+  set_table_cache_size(0);
+  cout << "evicted table still valid";
+  check(v1->size() == 10 && (*v1)[0] == 1);
+
+  // pi(x) using the cached tables
+  int64_t x = 1000000000000ll;
+  int64_t pix = pi(x);
+  set_table_cache_size(4);
+
+  for (int threads = 1; threads <= 3; threads++)
+  {
+    int64_t res = pi(x, threads);
+    cout << "pi(" << x << ", threads = " << threads << ") = " << res;
+    check(res == pix);
+  }
+
+  set_table_cache_size(0);
+
+  cout << endl;
+  cout << "All tests passed successfully!" << endl;
+
+  return 0;
+}